@@ -1,4 +1,8 @@
 #include "dna.h"
+#include "dict.h"
+#include "thread_pool.h"
+#include "rng.h"
+#include "arena.h"
 
 typedef double fit_fn(network_t N);
 
@@ -26,8 +30,27 @@ struct species_list_header {
 };
 typedef struct species_list_header species_list;
 
+enum inovation_scope_header{
+  INOVATION_SCOPE_RUN,
+  INOVATION_SCOPE_LIVING,
+  INOVATION_SCOPE_GENERATION
+};
+typedef enum inovation_scope_header inovation_scope;
+
+#define SPECIES_HASH(id) (id)
+#define SPECIES_EQUIV(id1, id2) ((id1) == (id2))
+DICT_DEFINE(species_dict, species_id, species_list *, SPECIES_HASH, SPECIES_EQUIV)
+
+#define GENE_HASH(id) (id)
+#define GENE_EQUIV(id1, id2) ((id1) == (id2))
+DICT_DEFINE(gene_set, gene_id, bool, GENE_HASH, GENE_EQUIV)
+// the last generation each gene carried by the population was active in
+DICT_DEFINE(gene_history, gene_id, size_t, GENE_HASH, GENE_EQUIV)
+
 struct neat_header {
   size_t size; // > 1
+  size_t input;
+  size_t output;
   double dist_thresh;
   double c1;
   double c2;
@@ -35,10 +58,47 @@ struct neat_header {
   individual **individuals;
   species_list *species;
   inovation_counter_t counter;
+  inovation_scope scope;
+  size_t purge_after; // generations a gene may stay disabled, 0 never purges
+  size_t generation;
+  gene_history history;
   fit_fn *fit;
+  activation_fn *activation;
+  thread_pool_t pool;
+  rng_t rng;
+  rng_t *thread_rngs; // one per thread in pool
+  // one per thread in pool, reading through to counter so genes found while
+  // breeding in parallel only get their IDs once the children are in order
+  inovation_counter_t *thread_counters;
+  // a generation lives in one arena while the next is bred in the other, and
+  // the old one is reset in a single step once the new generation replaces it
+  arena_t gen_arena;
+  arena_t next_arena;
 };
 typedef struct neat_header neat;
 
+struct fitness_job_header {
+  individual **individuals;
+  fit_fn *fit;
+};
+typedef struct fitness_job_header fitness_job;
+
+struct offspring_header {
+  dna_t dom;
+  dna_t rec;
+  bool mutate;
+  uint64_t seed;
+};
+typedef struct offspring_header offspring;
+
+struct reproduction_job_header {
+  neat *N;
+  offspring *plan;
+  individual *children;
+  individual **next_gen;
+};
+typedef struct reproduction_job_header reproduction_job;
+
 void sort_individuals(individual **individuals, size_t lo, size_t hi) {
   if (lo == hi || lo == hi - 1)
     return;
@@ -75,8 +135,8 @@ void sort_individuals(individual **individuals, size_t lo, size_t hi) {
 size_t num_same_species(neat *N, dna_t D) {
   size_t count = 0;
   for (size_t i = 0; i < N->size; i++) {
-    if (dna_distance(D, N->individuals[i]->dna, N->c1, N->c2, N->c3) <
-        N->dist_thresh) {
+    if (dna_distance_bounded(D, N->individuals[i]->dna, N->c1, N->c2, N->c3,
+                             N->dist_thresh) < N->dist_thresh) {
       count++;
     }
   }
@@ -88,7 +148,7 @@ species_id get_species(species_list *list, dna_t D, double c1, double c2,
   species_id id = 0;
   species *S = list->start;
   while (S != NULL) {
-    if (dna_distance(S->dna, D, c1, c2, c3) < dist_thresh)
+    if (dna_distance_bounded(S->dna, D, c1, c2, c3, dist_thresh) < dist_thresh)
       return id;
     id++;
     S = S->next;
@@ -123,12 +183,6 @@ species_list *get_new_species_list(neat *N) {
   return list;
 }
 
-unsigned int species_hash(key k) { return *((species_id *)k); }
-
-bool species_equiv(key k1, key k2) {
-  return *((species_id *)k1) == *((species_id *)k2);
-}
-
 void species_list_free(species_list *list) {
   species *S = list->start;
   while (S != NULL) {
@@ -140,34 +194,227 @@ void species_list_free(species_list *list) {
   free(list);
 }
 
+void evaluate_fitness(void *arg, size_t i, size_t thread) {
+  (void)thread;
+  fitness_job *job = (fitness_job *)arg;
+  individual *I = job->individuals[i];
+  I->fit = (*job->fit)(I->net);
+}
+
+// evaluates every individual in the array on the thread pool
+void evaluate_individuals(neat *N, individual **individuals) {
+  fitness_job job;
+  job.individuals = individuals;
+  job.fit = N->fit;
+  thread_pool_run(N->pool, N->size, &evaluate_fitness, &job);
+}
+
+// breeds one child of the next generation, giving new genes provisional IDs
+void reproduce(void *arg, size_t i, size_t thread) {
+  reproduction_job *job = (reproduction_job *)arg;
+  neat *N = job->N;
+  offspring *O = &job->plan[i];
+  // seeding per child rather than per thread keeps runs reproducible no
+  // matter which thread breeds which child
+  rng_t R = N->thread_rngs[thread];
+  rng_seed(R, O->seed);
+  individual *I = &job->children[i];
+  I->dna = dna_combine(O->dom, O->rec, R);
+  if (O->mutate) {
+    inovation_counter_t counter = N->thread_counters[thread];
+    inovation_counter_clear(counter);
+    dna_mutate(I->dna, counter, R);
+  }
+  job->next_gen[i] = I;
+}
+
+// builds and evaluates one child of the next generation once its genes are
+// numbered
+void develop(void *arg, size_t i, size_t thread) {
+  (void)thread;
+  reproduction_job *job = (reproduction_job *)arg;
+  neat *N = job->N;
+  individual *I = job->next_gen[i];
+  I->net = dna_to_network(I->dna, N->activation);
+  I->fit = (*N->fit)(I->net);
+}
+
+void gene_set_insert(gene_set *live, const gene_id *id, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    gene_set_add(live, id[i], true);
+}
+
+bool gene_is_live(gene_id id, void *arg) {
+  return gene_set_get((gene_set *)arg, id) != NULL;
+}
+
+// drops every gene of the counter that neither an individual nor a species
+// representative carries
+void compact_inovations(neat *N) {
+  gene_set live;
+  gene_set_init(&live, inovation_counter_get_size(N->counter));
+  const gene_id *last = NULL;
+  for (size_t i = 0; i < N->size; i++) {
+    size_t n;
+    const gene_id *id = dna_get_inovations(N->individuals[i]->dna, &n);
+    // children of the same parent often still share its genes
+    if (id == last)
+      continue;
+    last = id;
+    gene_set_insert(&live, id, n);
+  }
+  for (species *S = N->species->start; S != NULL; S = S->next) {
+    size_t n;
+    const gene_id *id = dna_get_inovations(S->dna, &n);
+    gene_set_insert(&live, id, n);
+  }
+  inovation_counter_retain(N->counter, &gene_is_live, &live);
+  gene_set_free(&live);
+}
+
+bool gene_is_recent(gene_id id, void *arg) {
+  neat *N = (neat *)arg;
+  return N->generation - *gene_history_get(&N->history, id) <= N->purge_after;
+}
+
+// records which genes are active in the current generation and drops the ones
+// no genome has had active for more than purge_after generations
+void purge_genes(neat *N) {
+  size_t n = N->size + N->species->num_species;
+  dna_t *genomes = malloc(n * sizeof(dna_t));
+  for (size_t i = 0; i < N->size; i++)
+    genomes[i] = N->individuals[i]->dna;
+  species *S = N->species->start;
+  for (size_t i = N->size; i < n; i++, S = S->next)
+    genomes[i] = S->dna;
+
+  // rebuilt from scratch so genes that died out don't stay in the history
+  gene_history history;
+  gene_history_init(&history, gene_history_size(&N->history));
+  bool stale = false;
+  for (size_t i = 0; i < n; i++) {
+    size_t num_genes;
+    const gene_id *id = dna_get_inovations(genomes[i], &num_genes);
+    const bool *active = dna_get_activity(genomes[i]);
+    for (size_t g = 0; g < num_genes; g++) {
+      size_t *last = gene_history_get(&history, id[g]);
+      if (last == NULL) {
+        last = gene_history_get(&N->history, id[g]);
+        last = gene_history_add(&history, id[g],
+                                last == NULL ? N->generation : *last);
+      }
+      if (active[g])
+        *last = N->generation;
+    }
+  }
+  size_t i = 0;
+  size_t last;
+  while (gene_history_next(&history, &i, NULL, &last))
+    stale |= N->generation - last > N->purge_after;
+  gene_history_free(&N->history);
+  N->history = history;
+
+  if (stale)
+    dna_purge(genomes, n, &gene_is_recent, N);
+  free(genomes);
+}
+
+// the first generation is built lazily so that settings like the number of
+// threads apply to it
+void neat_init_gen(neat *N) {
+  if (N->individuals != NULL)
+    return;
+
+  N->individuals = arena_alloc(N->gen_arena, N->size * sizeof(individual *));
+  individual *first = arena_alloc(N->gen_arena, N->size * sizeof(individual));
+  for (size_t i = 0; i < N->size; i++) {
+    individual *I = &first[i];
+    I->dna = dna_new(N->input, N->output);
+    dna_mutate(I->dna, N->counter, N->rng);
+    I->net = dna_to_network(I->dna, N->activation);
+    N->individuals[i] = I;
+  }
+  evaluate_individuals(N, N->individuals);
+  sort_individuals(N->individuals, 0, N->size);
+  N->species = get_new_species_list(N);
+}
+
 neat *neat_new(size_t size, size_t input, size_t output, double dist_thresh,
                double c1, double c2, double c3, fit_fn *fit,
                activation_fn *activation) {
   neat *N = malloc(sizeof(neat));
   N->size = size;
-  N->individuals = malloc(size * sizeof(individual *));
+  N->input = input;
+  N->output = output;
+  N->individuals = NULL;
+  N->species = NULL;
   N->counter = dna_make_inovation_counter(size);
-  for (size_t i = 0; i < size; i++) {
-    individual *I = malloc(sizeof(individual));
-    I->dna = dna_new(input, output);
-    dna_mutate(I->dna, N->counter);
-    I->net = dna_to_network(I->dna, activation);
-    I->fit = (*fit)(I->net);
-    N->individuals[i] = I;
-  }
+  N->scope = INOVATION_SCOPE_RUN;
+  N->purge_after = 0;
+  N->generation = 0;
+  gene_history_init(&N->history, 0);
   N->dist_thresh = dist_thresh;
   N->c1 = c1;
   N->c2 = c2;
   N->c3 = c3;
   N->fit = fit;
-  sort_individuals(N->individuals, 0, N->size);
-  N->species = get_new_species_list(N);
+  N->activation = activation;
+  N->pool = thread_pool_new(1);
+  N->rng = rng_new((uint64_t)rand());
+  N->thread_rngs = malloc(sizeof(rng_t));
+  N->thread_rngs[0] = rng_new(0);
+  N->thread_counters = malloc(sizeof(inovation_counter_t));
+  N->thread_counters[0] = inovation_counter_new_deferred(N->counter);
+  N->gen_arena = arena_new(size * (sizeof(individual) + sizeof(individual *)));
+  N->next_arena = arena_new(size * (sizeof(individual) + sizeof(individual *)));
   return N;
 }
 
-double neat_best_fitness(neat *N) { return N->individuals[0]->fit; }
+void neat_set_threads(neat *N, size_t threads) {
+  size_t old_threads = thread_pool_get_threads(N->pool);
+  if (threads == old_threads)
+    return;
+  thread_pool_free(N->pool);
+  N->pool = thread_pool_new(threads);
+  for (size_t i = 0; i < old_threads; i++) {
+    rng_free(N->thread_rngs[i]);
+    inovation_counter_free(N->thread_counters[i]);
+  }
+  free(N->thread_rngs);
+  free(N->thread_counters);
+  N->thread_rngs = malloc(threads * sizeof(rng_t));
+  N->thread_counters = malloc(threads * sizeof(inovation_counter_t));
+  for (size_t i = 0; i < threads; i++) {
+    N->thread_rngs[i] = rng_new(0);
+    N->thread_counters[i] = inovation_counter_new_deferred(N->counter);
+  }
+}
+
+void neat_set_seed(neat *N, uint64_t seed) { rng_seed(N->rng, seed); }
+
+void neat_set_inovation_scope(neat *N, inovation_scope scope) {
+  N->scope = scope;
+}
+
+void neat_set_gene_purge(neat *N, size_t generations) {
+  N->purge_after = generations;
+}
+
+size_t neat_get_inovation_genes(neat *N) {
+  return inovation_counter_get_size(N->counter);
+}
+
+size_t neat_get_inovation_bytes(neat *N) {
+  return inovation_counter_get_bytes(N->counter);
+}
+
+double neat_best_fitness(neat *N) {
+  neat_init_gen(N);
+  return N->individuals[0]->fit;
+}
 
 double *neat_n_best_fitness(neat *N, size_t n) {
+  neat_init_gen(N);
   double *fitness = malloc(n * sizeof(double));
   for (size_t i = 0; i < n; i++) {
     fitness[i] = N->individuals[i]->fit;
@@ -178,10 +425,14 @@ double *neat_n_best_fitness(neat *N, size_t n) {
 double *neat_gen_fitness(neat *N) { return neat_n_best_fitness(N, N->size); }
 
 // no need to free network
-network_t neat_get_most_fit(neat *N) { return N->individuals[0]->net; }
+network_t neat_get_most_fit(neat *N) {
+  neat_init_gen(N);
+  return N->individuals[0]->net;
+}
 
 // need to free array but not elements
 network_t *neat_get_n_most_fit(neat *N, size_t n) {
+  neat_init_gen(N);
   network_t *gen = malloc(n * sizeof(network_t));
   for (size_t i = 0; i < n; i++) {
     gen[i] = N->individuals[i]->net;
@@ -193,23 +444,27 @@ network_t *neat_get_n_most_fit(neat *N, size_t n) {
 network_t *neat_get_gen(neat *N) { return neat_get_n_most_fit(N, N->size); }
 
 bool neat_next_gen(neat *N) {
-  dict_t species_dict = dict_new(N->species->num_species, &species_hash,
-                                 &species_equiv, &free, NULL);
+  neat_init_gen(N);
+  // everything allocated from the next generation's arena is either part of
+  // that generation or only needed until it is bred
+  arena_t A = N->next_arena;
+  species_dict groups;
+  species_dict_init(&groups, N->species->num_species);
   size_t num_old_species = N->species->num_species;
-  species **old_species = malloc(num_old_species * sizeof(species *));
+  species **old_species = arena_alloc(A, num_old_species * sizeof(species *));
   species *temp = N->species->start;
   for (size_t i = 0; i < num_old_species; i++) {
     old_species[i] = temp;
     temp = temp->next;
   }
   
-  species_id *id = malloc(sizeof(species_id));
   for (size_t i = 0; i < N->size; i++) {
-    *id = get_species(N->species, N->individuals[i]->dna, N->c1, N->c2, N->c3,
-                      N->dist_thresh);
-    species_list *list = (species_list *)dict_get(species_dict, id);
-    if (list != NULL) {
-      list->end->next = malloc(sizeof(species));
+    species_id id = get_species(N->species, N->individuals[i]->dna, N->c1,
+                                N->c2, N->c3, N->dist_thresh);
+    species_list **found = species_dict_get(&groups, id);
+    if (found != NULL) {
+      species_list *list = *found;
+      list->end->next = arena_alloc(A, sizeof(species));
       list->end = list->end->next;
       list->end->dna = N->individuals[i]->dna;
       list->end->fit = N->individuals[i]->fit;
@@ -217,8 +472,8 @@ bool neat_next_gen(neat *N) {
       list->end->next = NULL;
       list->num_species++;
     } else {
-      list = malloc(sizeof(species_list));
-      list->start = malloc(sizeof(species));
+      species_list *list = arena_alloc(A, sizeof(species_list));
+      list->start = arena_alloc(A, sizeof(species));
       list->end = list->start;
       list->num_species = 1;
 
@@ -227,9 +482,9 @@ bool neat_next_gen(neat *N) {
       list->end->stag_count = 0;
       list->end->next = NULL;
 
-      dict_add(species_dict, (key)id, (entry)list);
+      species_dict_add(&groups, id, list);
       
-      if (*id == N->species->num_species) {
+      if (id == N->species->num_species) {
         N->species->end->next = malloc(sizeof(species));
         N->species->end = N->species->end->next;
         N->species->end->dna = dna_copy(N->individuals[i]->dna);
@@ -238,17 +493,16 @@ bool neat_next_gen(neat *N) {
         N->species->end->next = NULL;
         N->species->num_species++;
       }
-      id = malloc(sizeof(species_id));
     }
   }
 
   species_list **species_groups =
-      malloc(N->species->num_species * sizeof(species_list *));
-  double *fitness = malloc(N->species->num_species * sizeof(double));
+      arena_alloc(A, N->species->num_species * sizeof(species_list *));
+  double *fitness = arena_alloc(A, N->species->num_species * sizeof(double));
   double total_fitness = 0;
   for (size_t i = 0; i < N->species->num_species; i++) {
-    *id = i;
-    species_list *list = (species_list *)dict_get(species_dict, id);
+    species_list **found = species_dict_get(&groups, (species_id)i);
+    species_list *list = found == NULL ? NULL : *found;
     species_groups[i] = list;
     if(list == NULL){
       fitness[i] = 0;
@@ -274,27 +528,14 @@ bool neat_next_gen(neat *N) {
     }
     total_fitness += fitness[i];
   }
-  free(id);
-  dict_free(species_dict);
-  free(old_species);
+  species_dict_free(&groups);
 
   if (total_fitness == 0) {
-    free(fitness);
-    for (size_t i = 0; i < num_old_species; i++) {
-      if(species_groups[i] == NULL) continue;
-      temp = species_groups[i]->start;
-      while (temp != NULL) {
-        species *next = temp->next;
-        free(temp);
-        temp = next;
-      }
-      free(species_groups[i]);
-    }
-    free(species_groups);
+    arena_reset(A);
     return false;
   }
 
-  size_t *num_offspring = malloc(N->species->num_species * sizeof(size_t));
+  size_t *num_offspring = arena_alloc(A, N->species->num_species * sizeof(size_t));
   size_t rem = N->size;
   size_t last = 0;
   for (size_t i = 0; i < N->species->num_species; i++) {
@@ -303,9 +544,9 @@ bool neat_next_gen(neat *N) {
     if(num_offspring[i] != 0) last = i;
   }
   num_offspring[last] += rem;
-  free(fitness);
 
-  individual **next_gen = malloc(N->size * sizeof(individual *));
+  // pick every child's parents up front so the children can be bred in parallel
+  offspring *plan = arena_alloc(A, N->size * sizeof(offspring));
   size_t index = 0;
   for (size_t i = 0; i < N->species->num_species; i++) {
     if (num_offspring[i] == 0)
@@ -316,29 +557,42 @@ bool neat_next_gen(neat *N) {
                              ? species_groups[i]->num_species
                              : species_groups[i]->num_species / 2;
     for (size_t j = 0; j < num_offspring[i]; j++) {
-      individual *I = malloc(sizeof(individual));
+      offspring *O = &plan[index];
+      O->dom = temp->dna;
       if (j % num_parents != 0) {
-        I->dna = dna_combine(temp->dna, temp->next->dna);
+        O->rec = temp->next->dna;
         temp = temp->next;
       } else {
-        I->dna = dna_combine(temp->dna, species_groups[i]->start->dna);
+        O->rec = species_groups[i]->start->dna;
         temp = species_groups[i]->start;
       }
-      if (j > 0 || species_groups[i]->num_species < 5)
-        dna_mutate(I->dna, N->counter);
-      I->net = dna_to_network(I->dna,
-                              network_get_activation(N->individuals[0]->net));
-      I->fit = (*N->fit)(I->net);
-      next_gen[index] = I;
+      O->mutate = j > 0 || species_groups[i]->num_species < 5;
+      O->seed = rng_next(N->rng);
       index++;
     }
   }
 
-  for (size_t i = 0; i < N->size; i++) {
+  // genes found while breeding this generation are only matched against each
+  // other
+  if (N->scope == INOVATION_SCOPE_GENERATION)
+    inovation_counter_clear(N->counter);
+
+  individual **next_gen = arena_alloc(A, N->size * sizeof(individual *));
+  reproduction_job job;
+  job.N = N;
+  job.plan = plan;
+  job.children = arena_alloc(A, N->size * sizeof(individual));
+  job.next_gen = next_gen;
+  gene_id first = inovation_counter_get_next(N->counter);
+  thread_pool_run(N->pool, N->size, &reproduce, &job);
+  // numbering in child order makes every gene's ID independent of which
+  // thread found it first
+  for (size_t i = 0; i < N->size; i++)
+    dna_number_genes(next_gen[i]->dna, first, N->counter);
+  thread_pool_run(N->pool, N->size, &develop, &job);
+
+  for (size_t i = 0; i < N->size; i++)
     network_free(N->individuals[i]->net);
-    free(N->individuals[i]);
-  }
-  free(N->individuals);
   N->individuals = next_gen;
   sort_individuals(N->individuals, 0, N->size);
 
@@ -359,7 +613,7 @@ bool neat_next_gen(neat *N) {
       N->species->num_species--;
     } else {
       species_list *group = species_groups[i];
-      size_t member = rand() % group->num_species;
+      size_t member = rng_below(N->rng, group->num_species);
       species *S = group->start;
       for (size_t j = 0; j < member; j++)
         S = S->next;
@@ -369,13 +623,25 @@ bool neat_next_gen(neat *N) {
       temp = temp->next;
     }
   }
-  free(num_offspring);
 
-  for (size_t i = 0; i < num_old_species; i++){
-    if(species_groups[i] != NULL) species_list_free(species_groups[i]);
+  // the old generation's genomes are only reachable through the groups
+  for (size_t i = 0; i < num_old_species; i++) {
+    if (species_groups[i] == NULL)
+      continue;
+    for (species *S = species_groups[i]->start; S != NULL; S = S->next)
+      dna_free(S->dna);
   }
-  free(species_groups);
 
+  // the old generation is dead, so its arena is recycled for the one after
+  arena_reset(N->gen_arena);
+  N->next_arena = N->gen_arena;
+  N->gen_arena = A;
+
+  N->generation++;
+  if (N->purge_after > 0)
+    purge_genes(N);
+  if (N->scope == INOVATION_SCOPE_LIVING)
+    compact_inovations(N);
   return true;
 }
 
@@ -389,15 +655,26 @@ network_t *neat_get_nth_next_gen(neat *N, size_t n) {
 }
 
 void neat_free(neat *N) {
-  for (size_t i = 0; i < N->size; i++) {
-    dna_free(N->individuals[i]->dna);
-    network_free(N->individuals[i]->net);
-    free(N->individuals[i]);
-  }
-  free(N->individuals);
+  if (N->individuals != NULL) {
+    for (size_t i = 0; i < N->size; i++) {
+      dna_free(N->individuals[i]->dna);
+      network_free(N->individuals[i]->net);
+    }
 
-  species_list_free(N->species);
+    species_list_free(N->species);
+  }
+  arena_free(N->gen_arena);
+  arena_free(N->next_arena);
 
+  for (size_t i = 0; i < thread_pool_get_threads(N->pool); i++) {
+    rng_free(N->thread_rngs[i]);
+    inovation_counter_free(N->thread_counters[i]);
+  }
+  free(N->thread_rngs);
+  free(N->thread_counters);
+  thread_pool_free(N->pool);
+  rng_free(N->rng);
   inovation_counter_free(N->counter);
+  gene_history_free(&N->history);
   free(N);
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #ifndef NEAT_H
 #define NEAT_H
 
+#include <stdint.h>
 #include "dna.h"
 
 //Postcondition: Result >= 0
@@ -12,8 +13,21 @@ typedef double fit_fn(network_t N);
 
 typedef struct neat_header *neat_t;
 
+// how long the inovation counter remembers a gene, and so which genes discovered independently by
+// different networks are given the same ID
+enum inovation_scope_header{
+  INOVATION_SCOPE_RUN, // every gene keeps its ID for the whole run, the counter only grows
+  INOVATION_SCOPE_LIVING, // a gene is forgotten once no network of the population carries it
+  INOVATION_SCOPE_GENERATION // only genes discovered in the same generation share an ID, as in the NEAT paper
+};
+typedef enum inovation_scope_header inovation_scope;
+
 /**
  * @brief creates a new instance of NEAT
+ * 
+ * The first generation is created and evaluated the first time it is needed, so settings such as
+ * neat_set_threads also apply to it.
+ * 
  * @param size the number of networks in each generation
  * @param input the number of input nodes to each network
  * @param output the number of output nodes of each network
@@ -28,6 +42,73 @@ typedef struct neat_header *neat_t;
 //Postcondition: Result is not NULL
 neat_t neat_new(size_t size, size_t input, size_t output, double dist_thresh, double c1, double c2, double c3, fit_fn *fit, activation_fn *activation);
 
+/**
+ * @brief sets the number of threads used to breed and evaluate each generation
+ * 
+ * When threads > 1 the fitness function is called concurrently from several threads, so it must not
+ * modify shared state without synchronizing it. Defaults to 1.
+ * 
+ * @param N the NEAT instance to configure
+ * @param threads the number of threads to evaluate networks on
+ */
+//Precondition: N != NULL and threads > 0
+void neat_set_threads(neat_t N, size_t threads);
+
+/**
+ * @brief seeds the random number generator behind every stochastic decision NEAT makes
+ * 
+ * Every child draws from its own stream seeded from this generator, so a child makes the same random
+ * choices no matter which thread breeds it, and brand new genes are numbered in the order of the children
+ * that carry them. Setting the seed before the first generation is built makes a run fully reproducible
+ * with any number of threads. Defaults to a seed drawn from rand().
+ * 
+ * @param N the NEAT instance to seed
+ * @param seed the seed
+ */
+//Precondition: N != NULL
+void neat_set_seed(neat_t N, uint64_t seed);
+
+/**
+ * @brief sets how long genes are remembered by the inovation counter
+ * 
+ * With INOVATION_SCOPE_RUN the counter holds every gene ever created, so on long runs it keeps growing.
+ * The other two scopes keep it bounded by the genes of the current population or of the latest
+ * generation. A forgotten gene that is discovered again gets a new ID. Defaults to INOVATION_SCOPE_RUN.
+ * 
+ * @param N the NEAT instance to configure
+ * @param scope how long genes are remembered
+ */
+//Precondition: N != NULL
+void neat_set_inovation_scope(neat_t N, inovation_scope scope);
+
+/**
+ * @brief sets how long a gene may stay disabled before it is removed from every network
+ * 
+ * Genes are disabled when a node is inserted into their connection, and otherwise stay in the genome for
+ * good. After each generation, every gene that no network of the population has had active for more than
+ * the given number of generations is dropped from all of them, so genomes only grow with the connections
+ * that are actually in use. Defaults to 0, which never drops genes.
+ * 
+ * @param N the NEAT instance to configure
+ * @param generations the number of generations a gene may stay disabled, or 0 to keep every gene
+ */
+//Precondition: N != NULL
+void neat_set_gene_purge(neat_t N, size_t generations);
+
+/**
+ * @brief returns the number of genes remembered by the inovation counter
+ * @param N the NEAT instance to query
+ */
+//Precondition: N != NULL
+size_t neat_get_inovation_genes(neat_t N);
+
+/**
+ * @brief returns the number of bytes of memory held by the inovation counter
+ * @param N the NEAT instance to query
+ */
+//Precondition: N != NULL
+size_t neat_get_inovation_bytes(neat_t N);
+
 /**
  * @brief evaluates all networks in a generation and computes the next generation
  * @param N the NEAT instance to iterate
@@ -0,0 +1,61 @@
+#include <stdlib.h>
+#include "activation.h"
+
+double activation_identity(double x){
+  return activation_kernel_identity(x);
+}
+
+double activation_sigmoid(double x){
+  return activation_kernel_sigmoid(x);
+}
+
+double activation_signed_sigmoid(double x){
+  return activation_kernel_signed_sigmoid(x);
+}
+
+double activation_tanh(double x){
+  return activation_kernel_tanh(x);
+}
+
+double activation_relu(double x){
+  return activation_kernel_relu(x);
+}
+
+activation_fn *activation_get(activation_kind kind){
+  switch(kind){
+    case ACTIVATION_SIGMOID: return &activation_sigmoid;
+    case ACTIVATION_SIGNED_SIGMOID: return &activation_signed_sigmoid;
+    case ACTIVATION_TANH: return &activation_tanh;
+    case ACTIVATION_RELU: return &activation_relu;
+    default: return &activation_identity;
+  }
+}
+
+activation_kind activation_get_kind(activation_fn *F){
+  if(F == NULL || F == &activation_identity) return ACTIVATION_IDENTITY;
+  if(F == &activation_sigmoid) return ACTIVATION_SIGMOID;
+  if(F == &activation_signed_sigmoid) return ACTIVATION_SIGNED_SIGMOID;
+  if(F == &activation_tanh) return ACTIVATION_TANH;
+  if(F == &activation_relu) return ACTIVATION_RELU;
+  return ACTIVATION_CUSTOM;
+}
+
+void activation_apply(activation_kind kind, activation_fn *F, double *x, size_t n){
+#define APPLY_LOOP(ACT) for(size_t i = 0; i < n; i++) x[i] = ACT(x[i])
+  ACTIVATION_SPECIALIZE(kind, F, APPLY_LOOP)
+#undef APPLY_LOOP
+}
+
+void activation_axpy(activation_kind kind, activation_fn *F, double w, double *restrict x, double *restrict y, size_t n){
+#define AXPY_LOOP(ACT) for(size_t i = 0; i < n; i++) y[i] += ACT(w * x[i])
+  ACTIVATION_SPECIALIZE(kind, F, AXPY_LOOP)
+#undef AXPY_LOOP
+}
+
+double activation_dot(activation_kind kind, activation_fn *F, double *w, double *x, size_t n){
+  double sum = 0;
+#define DOT_LOOP(ACT) for(size_t i = 0; i < n; i++) sum += ACT(w[i] * x[i])
+  ACTIVATION_SPECIALIZE(kind, F, DOT_LOOP)
+#undef DOT_LOOP
+  return sum;
+}
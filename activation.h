@@ -0,0 +1,214 @@
+/**
+ * Built-in activation functions. Networks using one of these are evaluated with loops specialized for it
+ * instead of calling the activation through a function pointer on every connection, and the
+ * exponential-based ones use a polynomial approximation of exp that the compiler can vectorize. Any other
+ * activation_fn still works but takes the slower generic path.
+ */
+#ifndef ACTIVATION_H
+#define ACTIVATION_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef double activation_fn(double);
+
+enum activation_kind_header{
+  ACTIVATION_CUSTOM, // a user supplied activation_fn
+  ACTIVATION_IDENTITY, // x
+  ACTIVATION_SIGMOID, // 1 / (1 + e^(-4.9x)), the steepened sigmoid of the NEAT paper
+  ACTIVATION_SIGNED_SIGMOID, // 2 / (1 + e^(-4.9x)) - 1, the steepened sigmoid stretched to (-1, 1)
+  ACTIVATION_TANH, // tanh(x)
+  ACTIVATION_RELU // max(x, 0)
+};
+typedef enum activation_kind_header activation_kind;
+
+/**
+ * @brief returns the activation function of a built-in kind
+ * @param kind the kind of activation
+ */
+//Precondition: kind != ACTIVATION_CUSTOM
+//Postcondition: Result is not NULL
+activation_fn *activation_get(activation_kind kind);
+
+/**
+ * @brief returns the built-in kind of an activation function
+ * @param F the activation function, or NULL for the identity
+ */
+//Postcondition: Result is ACTIVATION_CUSTOM unless F was returned by activation_get or is NULL
+activation_kind activation_get_kind(activation_fn *F);
+
+/**
+ * @brief applies an activation to every value of an array in place
+ * @param kind the kind of activation
+ * @param F the activation function, only used when kind is ACTIVATION_CUSTOM
+ * @param x the values to activate
+ * @param n the number of values
+ */
+//Precondition: x != NULL
+void activation_apply(activation_kind kind, activation_fn *F, double *x, size_t n);
+
+/**
+ * @brief adds F(w * x[i]) to y[i] for every i < n
+ * @param kind the kind of activation
+ * @param F the activation function, only used when kind is ACTIVATION_CUSTOM
+ * @param w the weight to multiply x by
+ * @param x the values to scale
+ * @param y the values to add to
+ * @param n the number of values
+ */
+//Precondition: x != NULL, y != NULL, and x and y don't overlap
+void activation_axpy(activation_kind kind, activation_fn *F, double w, double *x, double *y, size_t n);
+
+/**
+ * @brief returns the sum of F(w[i] * x[i]) over every i < n
+ * @param kind the kind of activation
+ * @param F the activation function, only used when kind is ACTIVATION_CUSTOM
+ * @param w the weights
+ * @param x the values to weigh
+ * @param n the number of values
+ */
+//Precondition: w != NULL and x != NULL
+double activation_dot(activation_kind kind, activation_fn *F, double *w, double *x, size_t n);
+
+double activation_identity(double x);
+double activation_sigmoid(double x);
+double activation_signed_sigmoid(double x);
+double activation_tanh(double x);
+double activation_relu(double x);
+
+/**
+ * Scalar kernels for evaluators that specialize their own loops on the kind of activation. They are
+ * inline so the loops compile down to straight-line arithmetic.
+ */
+
+// e^x as 2^k * e^r with |r| <= ln(2) / 2 and e^r from its degree 12 Taylor polynomial, accurate to a
+// couple of units in the last place and free of library calls and branches. Adding 1.5 * 2^52 rounds to
+// an integer and leaves it in the low bits of the mantissa, Estrin's scheme keeps the dependency chain
+// short, and the high bits of k_bits shift out, leaving k + 1023 as the exponent of 2^k.
+//
+// The body is a macro over x so that export.c can write the same source into generated code, which then
+// rounds exactly like activation_exp.
+#define ACTIVATION_EXP_BODY                                                         \
+  x = x > 708.0 ? 708.0 : x;                                                        \
+  x = x < -708.0 ? -708.0 : x;                                                      \
+  double shifted = x * 1.4426950408889634 + 6755399441055744.0;                     \
+  uint64_t k_bits;                                                                  \
+  memcpy(&k_bits, &shifted, sizeof(double));                                        \
+  double k = shifted - 6755399441055744.0;                                          \
+  double r = (x - k * 6.93147180369123816490e-01) - k * 1.90821492927058770002e-10; \
+  double r2 = r * r;                                                                \
+  double r4 = r2 * r2;                                                              \
+  double r8 = r4 * r4;                                                              \
+  double p01 = 1.0 + r;                                                             \
+  double p23 = 1.0 / 2.0 + r * (1.0 / 6.0);                                         \
+  double p45 = 1.0 / 24.0 + r * (1.0 / 120.0);                                      \
+  double p67 = 1.0 / 720.0 + r * (1.0 / 5040.0);                                    \
+  double p89 = 1.0 / 40320.0 + r * (1.0 / 362880.0);                                \
+  double p1011 = 1.0 / 3628800.0 + r * (1.0 / 39916800.0);                          \
+  double p0_3 = p01 + r2 * p23;                                                     \
+  double p4_7 = p45 + r2 * p67;                                                     \
+  double p8_12 = p89 + r2 * p1011 + r4 * (1.0 / 479001600.0);                       \
+  double p = p0_3 + r4 * p4_7 + r8 * p8_12;                                         \
+  uint64_t bits = (k_bits + 1023) << 52;                                            \
+  double scale;                                                                     \
+  memcpy(&scale, &bits, sizeof(double));                                            \
+  return p * scale;
+
+static inline double activation_exp(double x){
+  ACTIVATION_EXP_BODY
+}
+
+static inline double activation_kernel_identity(double x){
+  return x;
+}
+
+static inline double activation_kernel_sigmoid(double x){
+  return 1.0 / (1.0 + activation_exp(-4.9 * x));
+}
+
+static inline double activation_kernel_signed_sigmoid(double x){
+  return 2.0 / (1.0 + activation_exp(-4.9 * x)) - 1.0;
+}
+
+static inline double activation_kernel_tanh(double x){
+  return 1.0 - 2.0 / (1.0 + activation_exp(2.0 * x));
+}
+
+static inline double activation_kernel_relu(double x){
+  return x > 0.0 ? x : 0.0;
+}
+
+// expands LOOP once per kind with the matching kernel as its argument, so every kind gets its own copy
+// of the loop with the activation inlined; custom activations go through the function pointer F
+#define ACTIVATION_SPECIALIZE(kind, F, LOOP)                                       \
+  switch(kind){                                                                    \
+    case ACTIVATION_IDENTITY: LOOP(activation_kernel_identity); break;             \
+    case ACTIVATION_SIGMOID: LOOP(activation_kernel_sigmoid); break;               \
+    case ACTIVATION_SIGNED_SIGMOID: LOOP(activation_kernel_signed_sigmoid); break; \
+    case ACTIVATION_TANH: LOOP(activation_kernel_tanh); break;                     \
+    case ACTIVATION_RELU: LOOP(activation_kernel_relu); break;                     \
+    default: LOOP((*(F))); break;                                                  \
+  }
+
+/**
+ * Single precision versions of the kernels, for evaluators that keep node values in floats and would
+ * lose half their vector width converting every product to double.
+ */
+
+// e^x as 2^k * e^r like activation_exp, with e^r from its degree 6 Taylor polynomial, which is enough for
+// float precision
+static inline float activation_expf(float x){
+  x = x > 87.0f ? 87.0f : x;
+  x = x < -87.0f ? -87.0f : x;
+  // adding 1.5 * 2^23 rounds to an integer and leaves it in the low bits of the mantissa
+  float shifted = x * 1.44269504f + 12582912.0f;
+  uint32_t k_bits;
+  memcpy(&k_bits, &shifted, sizeof(float));
+  float k = shifted - 12582912.0f;
+  float r = (x - k * 0.693359375f) - k * -2.12194440e-4f;
+  float r2 = r * r;
+  float r4 = r2 * r2;
+  float p01 = 1.0f + r;
+  float p23 = 1.0f / 2.0f + r * (1.0f / 6.0f);
+  float p45 = 1.0f / 24.0f + r * (1.0f / 120.0f);
+  float p = p01 + r2 * p23 + r4 * (p45 + r2 * (1.0f / 720.0f));
+  // the high bits of k_bits shift out, leaving k + 127 as the exponent of 2^k
+  uint32_t bits = (k_bits + 127) << 23;
+  float scale;
+  memcpy(&scale, &bits, sizeof(float));
+  return p * scale;
+}
+
+static inline float activation_kernelf_identity(float x){
+  return x;
+}
+
+static inline float activation_kernelf_sigmoid(float x){
+  return 1.0f / (1.0f + activation_expf(-4.9f * x));
+}
+
+static inline float activation_kernelf_signed_sigmoid(float x){
+  return 2.0f / (1.0f + activation_expf(-4.9f * x)) - 1.0f;
+}
+
+static inline float activation_kernelf_tanh(float x){
+  return 1.0f - 2.0f / (1.0f + activation_expf(2.0f * x));
+}
+
+static inline float activation_kernelf_relu(float x){
+  return x > 0.0f ? x : 0.0f;
+}
+
+// ACTIVATION_SPECIALIZE with the float kernels; custom activations are still called in double precision
+#define ACTIVATION_SPECIALIZE_FLOAT(kind, F, LOOP)                                  \
+  switch(kind){                                                                     \
+    case ACTIVATION_IDENTITY: LOOP(activation_kernelf_identity); break;             \
+    case ACTIVATION_SIGMOID: LOOP(activation_kernelf_sigmoid); break;               \
+    case ACTIVATION_SIGNED_SIGMOID: LOOP(activation_kernelf_signed_sigmoid); break; \
+    case ACTIVATION_TANH: LOOP(activation_kernelf_tanh); break;                     \
+    case ACTIVATION_RELU: LOOP(activation_kernelf_relu); break;                     \
+    default: LOOP((float)(*(F))); break;                                            \
+  }
+
+#endif // ACTIVATION_H
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <stddef.h>
+
+typedef struct arena_block_header arena_block;
+struct arena_block_header{
+  arena_block *next; // the block filled before this one
+  size_t compacity;
+  size_t used;
+  max_align_t data[];
+};
+
+struct arena_header{
+  arena_block *blocks; // the block being filled, newest first
+  size_t compacity; // total bytes across every block
+};
+typedef struct arena_header arena;
+
+//helper functions
+
+#define ARENA_ALIGN (_Alignof(max_align_t))
+
+arena_block *arena_block_new(size_t compacity, arena_block *next){
+  arena_block *B = malloc(sizeof(arena_block) + compacity);
+  B->next = next;
+  B->compacity = compacity;
+  B->used = 0;
+  return B;
+}
+//end helper functions
+
+arena *arena_new(size_t compacity){
+  arena *A = malloc(sizeof(arena));
+  if(compacity < 4096) compacity = 4096;
+  A->blocks = arena_block_new(compacity, NULL);
+  A->compacity = compacity;
+  return A;
+}
+
+void *arena_alloc(arena *A, size_t bytes){
+  bytes = (bytes + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  arena_block *B = A->blocks;
+  if(B->compacity - B->used < bytes){
+    // doubling keeps the number of blocks logarithmic in the high-water mark
+    size_t compacity = 2 * B->compacity;
+    if(compacity < bytes) compacity = bytes;
+    B = arena_block_new(compacity, B);
+    A->blocks = B;
+    A->compacity += compacity;
+  }
+  void *p = (char *)B->data + B->used;
+  B->used += bytes;
+  return p;
+}
+
+void arena_reset(arena *A){
+  if(A->blocks->next == NULL){
+    A->blocks->used = 0;
+    return;
+  }
+  // merge every block into one big enough for the most this arena has held, so the next round of
+  // allocations never has to grow it
+  arena_block *B = A->blocks;
+  while(B != NULL){
+    arena_block *next = B->next;
+    free(B);
+    B = next;
+  }
+  A->blocks = arena_block_new(A->compacity, NULL);
+}
+
+size_t arena_get_bytes(arena *A){
+  return A->compacity;
+}
+
+void arena_free(arena *A){
+  arena_block *B = A->blocks;
+  while(B != NULL){
+    arena_block *next = B->next;
+    free(B);
+    B = next;
+  }
+  free(A);
+}
@@ -0,0 +1,53 @@
+/**
+ * A region allocator for data that all dies at the same time. Allocation bumps a pointer through a block
+ * of memory, and arena_reset releases everything allocated so far at once. Memory is kept across resets,
+ * and once an arena has been reset it serves its next round of allocations from a single block sized to
+ * the most it has ever held, so an arena reused for work of a steady size stops calling malloc entirely.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+
+typedef struct arena_header *arena_t;
+
+/**
+ * @brief creates a new arena
+ * @param compacity the number of bytes to reserve up front
+ */
+//Postcondition: Result is not NULL
+arena_t arena_new(size_t compacity);
+
+/**
+ * @brief allocates memory that lives until the arena is next reset or freed
+ * @param A the arena to allocate from
+ * @param bytes the number of bytes to allocate
+ */
+//Precondition: A != NULL
+//Postcondition: Result is not NULL and aligned for any type
+void *arena_alloc(arena_t A, size_t bytes);
+
+/**
+ * @brief releases everything allocated from an arena while keeping its memory for reuse
+ * @param A the arena to reset
+ */
+//Precondition: A != NULL
+//Postcondition: every pointer returned by arena_alloc on A is invalid
+void arena_reset(arena_t A);
+
+/**
+ * @brief returns the number of bytes an arena holds from the system
+ * @param A the arena to query
+ */
+//Precondition: A != NULL
+size_t arena_get_bytes(arena_t A);
+
+/**
+ * @brief frees an arena and everything allocated from it
+ * @param A the arena to free
+ */
+//Precondition: A != NULL
+//Postcondition: A is freed
+void arena_free(arena_t A);
+
+#endif // ARENA_H
@@ -4,13 +4,6 @@
 typedef void *entry;
 typedef void *key;
 
-typedef struct dict_node dict_node;
-struct dict_node {
-  key key;
-  entry entry;
-  dict_node *next;
-};
-
 typedef unsigned int key_hash_fn(key k);
 typedef bool key_equiv_fn(key k1, key k2);
 typedef void key_free_fn(key k);
@@ -18,10 +11,19 @@ typedef void entry_free_fn(entry k);
 typedef key key_copy_fn(key k);
 typedef entry entry_copy_fn(entry k);
 
+// a slot is free when its entry is NULL, which dict_add never stores
+struct dict_slot_header{
+  key key;
+  entry entry;
+  unsigned int hash;
+};
+typedef struct dict_slot_header dict_slot;
+
+// open addressing with linear probing over a power of two number of slots
 struct dict_header{
   size_t size;
   size_t compacity;
-  dict_node **buckets;
+  dict_slot *slots;
   key_hash_fn *hash;
   key_equiv_fn *equiv;
   key_free_fn *key_free;
@@ -29,103 +31,95 @@ struct dict_header{
 };
 typedef struct dict_header dict;
 
-dict *dict_new(size_t compacity, key_hash_fn *hash, key_equiv_fn *equiv, key_free_fn key_free, entry_free_fn *entry_free){
-  dict *D = malloc(sizeof(dict));
-  D->size = 0;
-  D->compacity = compacity;
-  D->buckets = calloc(compacity, sizeof(dict_node *));
-  D->hash = hash;
-  D->equiv = equiv;
-  D->key_free = key_free;
-  D->entry_free = entry_free;
-  return D;
-}
+//helper functions
 
-unsigned int dict_hash(dict *D, key k){
-  return (*D->hash)(k) % D->compacity;
+size_t dict_home(dict *D, unsigned int hash){
+  return (size_t)(((unsigned long long)hash * 0x9e3779b97f4a7c15u) >> 32) & (D->compacity - 1);
 }
 
-dict_node *find_node(dict *D, key k){
-  unsigned int hash = dict_hash(D, k);
-  dict_node *node = D->buckets[hash];
-  while(node != NULL){
-    if((*D->equiv)(node->key, k)) return node;
-    node = node->next;
+// the slot holding k, or the free slot where it would go
+size_t dict_find(dict *D, key k, unsigned int hash){
+  size_t i = dict_home(D, hash);
+  while(D->slots[i].entry != NULL){
+    if(D->slots[i].hash == hash && (*D->equiv)(D->slots[i].key, k)) return i;
+    i = (i + 1) & (D->compacity - 1);
   }
-  return NULL;
+  return i;
 }
 
 void dict_resize(dict *D){
+  dict_slot *old = D->slots;
   size_t old_compacity = D->compacity;
   D->compacity *= 2;
-  dict_node **new_buckets = calloc(D->compacity, sizeof(dict_node *));
+  D->slots = calloc(D->compacity, sizeof(dict_slot));
   for(size_t i = 0; i < old_compacity; i++){
-    dict_node *node = D->buckets[i];
-    while(node != NULL){
-      dict_node *next = node->next;
-      unsigned int hash = dict_hash(D, node->key);
-      node->next = new_buckets[hash];
-      new_buckets[hash] = node;
-      node = next;
-    }
+    if(old[i].entry == NULL) continue;
+    size_t j = dict_home(D, old[i].hash);
+    while(D->slots[j].entry != NULL) j = (j + 1) & (D->compacity - 1);
+    D->slots[j] = old[i];
   }
-  free(D->buckets);
-  D->buckets = new_buckets;
+  free(old);
+}
+//end helper functions
+
+dict *dict_new(size_t compacity, key_hash_fn *hash, key_equiv_fn *equiv, key_free_fn key_free, entry_free_fn *entry_free){
+  dict *D = malloc(sizeof(dict));
+  D->size = 0;
+  D->compacity = 8;
+  while(D->compacity < compacity) D->compacity *= 2;
+  D->slots = calloc(D->compacity, sizeof(dict_slot));
+  D->hash = hash;
+  D->equiv = equiv;
+  D->key_free = key_free;
+  D->entry_free = entry_free;
+  return D;
 }
 
 void dict_add(dict *D, key k, entry e){
-  dict_node *node = find_node(D, k);
-  if(node != NULL){
-    if(D->entry_free != NULL) (*D->entry_free)(node->entry);
-    node->entry = e;
+  if(4 * (D->size + 1) > 3 * D->compacity) dict_resize(D);
+  unsigned int hash = (*D->hash)(k);
+  size_t i = dict_find(D, k, hash);
+  if(D->slots[i].entry != NULL){
+    if(D->entry_free != NULL) (*D->entry_free)(D->slots[i].entry);
+    D->slots[i].entry = e;
     return;
   }
-  node = malloc(sizeof(dict_node));
-  unsigned int hash = dict_hash(D, k);
-  node->key = k;
-  node->entry = e;
-  node->next = D->buckets[hash];
-  D->buckets[hash] = node;
+  D->slots[i].key = k;
+  D->slots[i].entry = e;
+  D->slots[i].hash = hash;
   D->size++;
-  if(D->size >= D->compacity * 1.5) dict_resize(D);
 }
 
 entry dict_get(dict *D, key k){
-  dict_node *node = find_node(D, k);
-  if(node == NULL) return NULL;
-  return node->entry;
+  return D->slots[dict_find(D, k, (*D->hash)(k))].entry;
 }
 
 entry dict_remove(dict *D, key k){
-  unsigned int hash = dict_hash(D, k);
-  dict_node *node = D->buckets[hash];
-  dict_node *prev = NULL;
-  while(node != NULL){
-    if((*D->equiv)(node->key, k)){
-      if(prev == NULL) D->buckets[hash] = node->next;
-      else prev->next = node->next;
-      if(D->key_free != NULL) (*D->key_free)(node->key);
-      entry e = node->entry;
-      free(node);
-      D->size--;
-      return e;
+  size_t mask = D->compacity - 1;
+  size_t i = dict_find(D, k, (*D->hash)(k));
+  entry e = D->slots[i].entry;
+  if(e == NULL) return NULL;
+  if(D->key_free != NULL) (*D->key_free)(D->slots[i].key);
+  // shift later keys of the same run back into the hole so lookups never need tombstones
+  for(size_t j = (i + 1) & mask; D->slots[j].entry != NULL; j = (j + 1) & mask){
+    size_t home = dict_home(D, D->slots[j].hash);
+    if(((j - home) & mask) >= ((j - i) & mask)){
+      D->slots[i] = D->slots[j];
+      i = j;
     }
   }
-  return NULL;
+  D->slots[i].entry = NULL;
+  D->size--;
+  return e;
 }
 
 dict *dict_copy(dict *D, key_copy_fn *key_copy, entry_copy_fn *entry_copy){
   dict *C = dict_new(D->compacity, D->hash, D->equiv, D->key_free, D->entry_free);
   for(size_t i = 0; i < D->compacity; i++){
-    dict_node *node = D->buckets[i];
-    while(node != NULL){
-      dict_node *new_node = malloc(sizeof(dict_node));
-      new_node->key = (*key_copy)(node->key);
-      new_node->entry = (*entry_copy)(node->entry);
-      new_node->next = C->buckets[i];
-      C->buckets[i] = new_node;
-      node = node->next;
-    }
+    if(D->slots[i].entry == NULL) continue;
+    C->slots[i].key = (*key_copy)(D->slots[i].key);
+    C->slots[i].entry = (*entry_copy)(D->slots[i].entry);
+    C->slots[i].hash = D->slots[i].hash;
   }
   C->size = D->size;
   return C;
@@ -133,15 +127,10 @@ dict *dict_copy(dict *D, key_copy_fn *key_copy, entry_copy_fn *entry_copy){
 
 void dict_free(dict *D){
   for(size_t i = 0; i < D->compacity; i++){
-    dict_node *node = D->buckets[i];
-    while(node != NULL){
-      dict_node *next = node->next;
-      if(D->key_free != NULL) (*D->key_free)(node->key);
-      if(D->entry_free != NULL) (*D->entry_free)(node->entry);
-      free(node);
-      node = next;
-    }
+    if(D->slots[i].entry == NULL) continue;
+    if(D->key_free != NULL) (*D->key_free)(D->slots[i].key);
+    if(D->entry_free != NULL) (*D->entry_free)(D->slots[i].entry);
   }
-  free(D->buckets);
+  free(D->slots);
   free(D);
-}
\ No newline at end of file
+}
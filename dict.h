@@ -5,12 +5,18 @@
     
     For copying the dictionary, it makes a deep copy and will require functions for making copies of the
     keys and the entries.
+
+    The dictionary uses open addressing: keys and entries are stored in one array of slots, so adding to
+    it only allocates when the table grows. For keys and entries of a fixed type, DICT_DEFINE generates a
+    typed dictionary that stores them by value and calls the hash and equivalence inline, so neither the
+    table nor its users allocate anything per key.
 */
 #ifndef DICT_H
 #define DICT_H
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef void *entry;
 typedef void *key;
@@ -84,4 +90,122 @@ dict_t dict_copy(dict_t D, key_copy_fn *key_copy, entry_copy_fn *entry_copy);
 //Postcondition: D is freed
 void dict_free(dict_t D);
 
+/**
+ * DICT_DEFINE(name, key_type, entry_type, hash, equiv) defines a dictionary type `name` from key_type to
+ * entry_type, both stored inline, and these functions on it:
+ * 
+ *   void name_init(name *D, size_t compacity)        creates an empty dictionary in D
+ *   entry_type *name_get(name *D, key_type k)        the entry of k, or NULL if k isn't in D
+ *   entry_type *name_add(name *D, key_type k, entry_type e)   adds or updates k, returns its entry
+ *   bool name_remove(name *D, key_type k)            removes k, returns false if it wasn't in D
+ *   bool name_next(name *D, size_t *i, key_type *k, entry_type *e)   iterates from *i = 0 until false
+ *   size_t name_size(name *D)                        the number of keys in D
+ *   size_t name_bytes(name *D)                       the memory held by the table
+ *   void name_clear(name *D)                         removes every key
+ *   void name_free(name *D)                          frees the table, D itself isn't freed
+ * 
+ * hash is called as hash(k) and must return an integer, equiv as equiv(k1, k2). Pointers returned by
+ * name_get and name_add are only valid until D is next added to or removed from.
+ */
+#define DICT_DEFINE(name, key_type, entry_type, hash, equiv)                                            \
+  struct name##_slot_header{                                                                            \
+    key_type key;                                                                                       \
+    entry_type entry;                                                                                   \
+    bool used;                                                                                          \
+  };                                                                                                    \
+  typedef struct name##_slot_header name##_slot;                                                        \
+  struct name##_header{                                                                                 \
+    size_t size;                                                                                        \
+    size_t compacity; /* always a power of two */                                                       \
+    name##_slot *slots;                                                                                 \
+  };                                                                                                    \
+  typedef struct name##_header name;                                                                    \
+                                                                                                        \
+  static inline size_t name##_home(name *D, key_type k){                                                \
+    return (size_t)(((uint64_t)(hash(k)) * 0x9e3779b97f4a7c15u) >> 32) & (D->compacity - 1);          \
+  }                                                                                                     \
+                                                                                                        \
+  /* the slot holding k, or the empty slot where it would go */                                        \
+  static inline size_t name##_find(name *D, key_type k){                                                \
+    size_t i = name##_home(D, k);                                                                       \
+    while(D->slots[i].used && !(equiv(D->slots[i].key, k))) i = (i + 1) & (D->compacity - 1);         \
+    return i;                                                                                           \
+  }                                                                                                     \
+                                                                                                        \
+  static inline void name##_init(name *D, size_t compacity){                                            \
+    D->size = 0;                                                                                        \
+    D->compacity = 8;                                                                                   \
+    while(D->compacity < compacity) D->compacity *= 2;                                                 \
+    D->slots = calloc(D->compacity, sizeof(name##_slot));                                               \
+  }                                                                                                     \
+                                                                                                        \
+  static inline entry_type *name##_get(name *D, key_type k){                                            \
+    size_t i = name##_find(D, k);                                                                       \
+    return D->slots[i].used ? &D->slots[i].entry : NULL;                                                \
+  }                                                                                                     \
+                                                                                                        \
+  static inline entry_type *name##_add(name *D, key_type k, entry_type e){                              \
+    if(4 * (D->size + 1) > 3 * D->compacity){                                                           \
+      name old = *D;                                                                                    \
+      name##_init(D, 2 * old.compacity);                                                                \
+      for(size_t j = 0; j < old.compacity; j++){                                                        \
+        if(old.slots[j].used) D->slots[name##_find(D, old.slots[j].key)] = old.slots[j];              \
+      }                                                                                                 \
+      D->size = old.size;                                                                               \
+      free(old.slots);                                                                                  \
+    }                                                                                                   \
+    size_t i = name##_find(D, k);                                                                       \
+    if(!D->slots[i].used){                                                                              \
+      D->slots[i].used = true;                                                                          \
+      D->slots[i].key = k;                                                                              \
+      D->size++;                                                                                        \
+    }                                                                                                   \
+    D->slots[i].entry = e;                                                                              \
+    return &D->slots[i].entry;                                                                          \
+  }                                                                                                     \
+                                                                                                        \
+  /* shifts later keys of the same run back into the hole so lookups never need tombstones */          \
+  static inline bool name##_remove(name *D, key_type k){                                                \
+    size_t mask = D->compacity - 1;                                                                     \
+    size_t i = name##_find(D, k);                                                                       \
+    if(!D->slots[i].used) return false;                                                                 \
+    for(size_t j = (i + 1) & mask; D->slots[j].used; j = (j + 1) & mask){                             \
+      size_t home = name##_home(D, D->slots[j].key);                                                    \
+      /* the key at j can fill the hole unless its home lies cyclically in (i, j] */                   \
+      if(((j - home) & mask) >= ((j - i) & mask)){                                                      \
+        D->slots[i] = D->slots[j];                                                                      \
+        i = j;                                                                                          \
+      }                                                                                                 \
+    }                                                                                                   \
+    D->slots[i].used = false;                                                                           \
+    D->size--;                                                                                          \
+    return true;                                                                                        \
+  }                                                                                                     \
+                                                                                                        \
+  static inline bool name##_next(name *D, size_t *i, key_type *k, entry_type *e){                       \
+    while(*i < D->compacity && !D->slots[*i].used) (*i)++;                                              \
+    if(*i == D->compacity) return false;                                                                \
+    if(k != NULL) *k = D->slots[*i].key;                                                                \
+    if(e != NULL) *e = D->slots[*i].entry;                                                              \
+    (*i)++;                                                                                             \
+    return true;                                                                                        \
+  }                                                                                                     \
+                                                                                                        \
+  static inline size_t name##_size(name *D){                                                            \
+    return D->size;                                                                                     \
+  }                                                                                                     \
+                                                                                                        \
+  static inline size_t name##_bytes(name *D){                                                           \
+    return D->compacity * sizeof(name##_slot);                                                          \
+  }                                                                                                     \
+                                                                                                        \
+  static inline void name##_clear(name *D){                                                             \
+    for(size_t j = 0; j < D->compacity; j++) D->slots[j].used = false;                                 \
+    D->size = 0;                                                                                        \
+  }                                                                                                     \
+                                                                                                        \
+  static inline void name##_free(name *D){                                                              \
+    free(D->slots);                                                                                     \
+  }
+
 #endif // DICT_H
\ No newline at end of file
@@ -1,39 +1,89 @@
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <assert.h>
 #include <math.h>
 #include "network.h"
-#include "dict.h"
 #include "inovation_counter.h"
+#include "rng.h"
+#include "dict.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 typedef unsigned int priority_t;
 
-typedef struct gene_header gene;
-struct gene_header{
-  gene_id id;
-  vertex start;
-  vertex end;
-  double weight;
-  bool active;
-  gene *next;
-};
-
 enum node_type_header{
   END,
   HIDDEN
 };
 typedef enum node_type_header node_type;
 
-struct cgene_header{
-  vertex start;
-  vertex end;
+// the parts of a genome that only change when its structure does, shared by copies of the genome until one
+// of them needs to change them: the sorted id, start and end of every gene and the connection set
+struct dna_structure_header{
+  atomic_size_t refs;
+  size_t compacity;
+  size_t connection_compacity; // a power of two at least twice the number of genes
+  uint64_t *connections; // open addressing set of the start << 32 | end of every gene
+  gene_id *id;
+  vertex *start;
+  vertex *end;
+};
+typedef struct dna_structure_header dna_structure;
+
+// the evaluation order of the nodes of a genome, shared the same way
+struct dna_nodes_header{
+  atomic_size_t refs;
+  size_t compacity;
+  priority_t *priority; // priority[v] is the position of vertex v in the evaluation order
+  vertex *order; // order[p] is the vertex with priority p
 };
-typedef struct cgene_header cgene;
+typedef struct dna_nodes_header dna_nodes;
+
+// the active connections of a genome as lists of edges into and out of every node, so adding a connection
+// only searches the nodes it can reorder. Built the first time a genome adds a connection and kept up to date
+// from then on, along with scratch space for the searches
+struct dna_graph_header{
+  size_t node_compacity;
+  size_t *out_head; // the first edge leaving each vertex
+  size_t *in_head; // the first edge entering each vertex
+  unsigned char *mark; // which search reached each vertex, 0 outside of dna_reorder
+  priority_t *forward; // the priorities of the nodes reachable from the end of a new connection
+  priority_t *backward; // the priorities of the nodes reaching its start
+  priority_t *positions;
+  vertex *moved;
+  size_t edge_compacity;
+  vertex *edge_start;
+  vertex *edge_end;
+  size_t *out_next; // the next edge leaving the same vertex, or the next unused edge
+  size_t *in_next;
+  size_t free_edges; // the first unused edge
+};
+typedef struct dna_graph_header dna_graph;
 
+// genes are stored sorted by id as parallel arrays. The weights and activity belong to the genome and share
+// one allocation with room for compacity genes; the rest points into the shared structure and node tables,
+// which are copied the first time this genome changes them while they are shared
 struct dna_header{
-  gene *start;
-  gene *end;
-  dict_t priority;
+  void *genes;
+  double *weight;
+  size_t *active_slot; // active_slot[g] is the position of active gene g in active_list
+  size_t *active_list; // the indices of the active genes, in no particular order
+  bool *active;
+  size_t compacity;
+  dna_structure *structure;
+  gene_id *id;
+  vertex *start;
+  vertex *end;
+  uint64_t *connections;
+  size_t connection_compacity;
+  dna_nodes *nodes;
+  priority_t *priority;
+  vertex *order;
+  dna_graph *graph; // NULL until the genome first adds a connection
   size_t num_genes;
   size_t num_active_genes;
   size_t size;
@@ -42,6 +92,27 @@ struct dna_header{
 };
 typedef struct dna_header dna;
 
+// marks an empty slot of the connection set, no connection has both ends at the largest vertex
+#define DNA_NO_CONNECTION UINT64_MAX
+
+// ends a list of edges of the graph
+#define DNA_NO_EDGE SIZE_MAX
+
+#define DNA_FORWARD 1
+#define DNA_BACKWARD 2
+
+// what purging does to one shared structure: the structure that replaces it, or NULL if no gene is
+// dropped, and which of its genes are dropped
+struct dna_purge_header{
+  dna_structure *purged;
+  bool *drop;
+};
+typedef struct dna_purge_header dna_purge_plan;
+
+#define STRUCTURE_HASH(S) ((uintptr_t)(S) >> 4)
+#define STRUCTURE_EQUIV(S1, S2) ((S1) == (S2))
+DICT_DEFINE(purge_dict, dna_structure *, dna_purge_plan, STRUCTURE_HASH, STRUCTURE_EQUIV)
+
 //helper funcions
 
 size_t min(size_t a, size_t b){
@@ -49,404 +120,815 @@ size_t min(size_t a, size_t b){
   return b;
 }
 
-void *uint_copy(void *i){
-  unsigned int *p = malloc(sizeof(unsigned int));
-  *p = *((unsigned int *)i);
-  return p;
+// the smallest power of two doubling of compacity, starting from at least 8, that holds n
+size_t grow_compacity(size_t compacity, size_t n){
+  if(n <= compacity) return compacity;
+  compacity = compacity < 8 ? 8 : compacity;
+  while(compacity < n) compacity *= 2;
+  return compacity;
 }
 
-double rand_norm(){
-  double sum = 0;
-  for(char i = 0; i < 10; i++){
-    sum += (double)rand() / (double)RAND_MAX;
-  }
-  return sum - 5;
+// creates a structure with one reference, room for compacity genes and an uninitialized connection set
+dna_structure *dna_structure_new(size_t compacity, size_t connection_compacity){
+  dna_structure *S = malloc(sizeof(dna_structure) + connection_compacity * sizeof(uint64_t) +
+                            compacity * (sizeof(gene_id) + 2 * sizeof(vertex)));
+  atomic_init(&S->refs, 1);
+  S->compacity = compacity;
+  S->connection_compacity = connection_compacity;
+  S->connections = (uint64_t *)(S + 1);
+  S->id = (gene_id *)(S->connections + connection_compacity);
+  S->start = (vertex *)(S->id + compacity);
+  S->end = S->start + compacity;
+  return S;
 }
 
-unsigned int vertex_hash(key k){
-  return *((vertex *)k);
+// creates node tables with one reference and room for compacity nodes
+dna_nodes *dna_nodes_new(size_t compacity){
+  dna_nodes *P = malloc(sizeof(dna_nodes) + compacity * (sizeof(priority_t) + sizeof(vertex)));
+  atomic_init(&P->refs, 1);
+  P->compacity = compacity;
+  P->priority = (priority_t *)(P + 1);
+  P->order = (vertex *)(P->priority + compacity);
+  return P;
 }
 
-bool vertex_equiv(key k1, key k2){
-  return *((vertex *)k1) == *((vertex *)k2);
+void dna_attach_structure(dna *D, dna_structure *S){
+  D->structure = S;
+  D->id = S->id;
+  D->start = S->start;
+  D->end = S->end;
+  D->connections = S->connections;
+  D->connection_compacity = S->connection_compacity;
 }
 
-unsigned int cgene_hash(key k){
-  cgene *C = (cgene *)k;
-  return 65537 * C->start + C->end;
+void dna_attach_nodes(dna *D, dna_nodes *P){
+  D->nodes = P;
+  D->priority = P->priority;
+  D->order = P->order;
 }
 
-bool cgene_equiv(key k1, key k2){
-  cgene *c1 = (cgene *)k1;
-  cgene *c2 = (cgene *)k2;
-  return c1->start == c2->start && c1->end == c2->end;
+void dna_release_structure(dna_structure *S){
+  if(atomic_fetch_sub(&S->refs, 1) == 1) free(S);
 }
 
-cgene *gene_to_cgene(dna *D, gene *G){
-  cgene *C = malloc(sizeof(cgene));
-  C->start = G->start;
-  C->end = G->end;
-  return C;
+void dna_release_nodes(dna_nodes *P){
+  if(atomic_fetch_sub(&P->refs, 1) == 1) free(P);
 }
 
-gene *gene_copy(gene* G){
-  gene *new_gene = malloc(sizeof(gene));
-  new_gene->id = G->id;
-  new_gene->start = G->start;
-  new_gene->end = G->end;
-  new_gene->weight = G->weight;
-  new_gene->active = G->active;
-  new_gene->next = NULL;
-  return new_gene;
+uint64_t connection_key(vertex start, vertex end){
+  return ((uint64_t)start << 32) | end;
 }
 
-gene *dna_get_active_gene(dna *D){
-  unsigned int mutation = rand() % D->num_active_genes;
-  gene *G = D->start;
-  unsigned int i = 0;
-  while(i < mutation || !G->active){
-    if(G->active) i++;
-    G = G->next;
-  }
-  return G;
+// the slot of the connection set holding k, or the empty slot where it would go
+size_t dna_find_connection(uint64_t *connections, size_t connection_compacity, uint64_t k){
+  size_t mask = connection_compacity - 1;
+  size_t i = (size_t)((k * 0x9e3779b97f4a7c15u) >> 32) & mask;
+  while(connections[i] != k && connections[i] != DNA_NO_CONNECTION) i = (i + 1) & mask;
+  return i;
 }
 
-bool dna_has_connection(dna *D, vertex start, vertex end, inovation_counter_t I){
-  cgene *C = malloc(sizeof(cgene));
-  C->start = start;
-  C->end = end;
-  gene_id *id = (gene_id *)inovation_counter_get(I, (key) C);
-  if(id != NULL){
-    gene *G = D->start;
-    while(G != NULL){
-      if(G->id >= *id){
-        free(C);
-        if(G->id == *id) return true;
-        return false;
-      }
-      G = G->next;
+// makes D the only owner of its structure and gives the structure room for n genes
+void dna_own_structure(dna *D, size_t n){
+  dna_structure *S = D->structure;
+  size_t compacity = grow_compacity(S->compacity, n);
+  size_t connection_compacity = S->connection_compacity;
+  while(2 * n > connection_compacity) connection_compacity *= 2;
+  if(atomic_load(&S->refs) == 1 && compacity == S->compacity && connection_compacity == S->connection_compacity) return;
+
+  dna_structure *own = dna_structure_new(compacity, connection_compacity);
+  memcpy(own->id, S->id, D->num_genes * sizeof(gene_id));
+  memcpy(own->start, S->start, D->num_genes * sizeof(vertex));
+  memcpy(own->end, S->end, D->num_genes * sizeof(vertex));
+  if(connection_compacity == S->connection_compacity){
+    memcpy(own->connections, S->connections, connection_compacity * sizeof(uint64_t));
+  } else{
+    memset(own->connections, 0xff, connection_compacity * sizeof(uint64_t));
+    for(size_t i = 0; i < S->connection_compacity; i++){
+      uint64_t k = S->connections[i];
+      if(k != DNA_NO_CONNECTION) own->connections[dna_find_connection(own->connections, connection_compacity, k)] = k;
     }
   }
-  free(C);
-  return false;
+  dna_release_structure(S);
+  dna_attach_structure(D, own);
 }
 
-void dna_add_gene(dna *D, gene *G){
-  D->num_genes++;
-  D->num_active_genes++;
-  if(D->start == NULL){
-    D->start = G;
-    D->end = G;
-    return;
+// makes D the only owner of its node tables and gives them room for n nodes
+void dna_own_nodes(dna *D, size_t n){
+  dna_nodes *P = D->nodes;
+  size_t compacity = n <= P->compacity ? P->compacity : 2 * P->compacity;
+  if(atomic_load(&P->refs) == 1 && compacity == P->compacity) return;
+
+  dna_nodes *own = dna_nodes_new(compacity);
+  memcpy(own->priority, P->priority, D->size * sizeof(priority_t));
+  memcpy(own->order, P->order, D->size * sizeof(vertex));
+  dna_release_nodes(P);
+  dna_attach_nodes(D, own);
+}
+
+size_t gene_bytes(size_t compacity){
+  return compacity * (sizeof(double) + 2 * sizeof(size_t) + sizeof(bool));
+}
+
+// points the weight and activity arrays of D into genes, a block with room for compacity genes
+void dna_layout(dna *D, void *genes, size_t compacity){
+  D->genes = genes;
+  D->compacity = compacity;
+  D->weight = (double *)genes;
+  D->active_slot = (size_t *)(D->weight + compacity);
+  D->active_list = D->active_slot + compacity;
+  D->active = (bool *)(D->active_list + compacity);
+}
+
+// creates DNA without genes, with room for the weights and activity of compacity genes, that takes over a
+// reference to S and P
+dna *dna_alloc(size_t input, size_t output, size_t size, size_t compacity, dna_structure *S, dna_nodes *P){
+  dna *D = malloc(sizeof(dna));
+  dna_layout(D, compacity == 0 ? NULL : malloc(gene_bytes(compacity)), compacity);
+  dna_attach_structure(D, S);
+  dna_attach_nodes(D, P);
+  D->graph = NULL;
+  D->num_genes = 0;
+  D->num_active_genes = 0;
+  D->size = size;
+  D->input = input;
+  D->output = output;
+  return D;
+}
+
+// copies the weights and activity of the first n genes of S into D, which must have room for them
+void dna_copy_genes(dna *D, dna *S, size_t n){
+  if(n == 0) return;
+  memcpy(D->weight, S->weight, n * sizeof(double));
+  memcpy(D->active, S->active, n * sizeof(bool));
+  memcpy(D->active_slot, S->active_slot, n * sizeof(size_t));
+  memcpy(D->active_list, S->active_list, S->num_active_genes * sizeof(size_t));
+}
+
+// grows the weight and activity arrays geometrically until they can hold n genes
+void dna_reserve(dna *D, size_t n){
+  if(n <= D->compacity) return;
+  dna old = *D;
+  dna_layout(D, malloc(gene_bytes(grow_compacity(D->compacity, n))), grow_compacity(D->compacity, n));
+  dna_copy_genes(D, &old, D->num_genes);
+  free(old.genes);
+}
+
+// returns the index of the first gene with an id greater than id
+size_t dna_upper_bound(dna *D, gene_id id){
+  size_t lo = 0;
+  size_t hi = D->num_genes;
+  while(lo < hi){
+    size_t mid = lo + (hi - lo) / 2;
+    if(D->id[mid] <= id) lo = mid + 1;
+    else hi = mid;
   }
-  if(D->start->id > G->id){
-    G->next = D->start;
-    D->start = G;
-    return;
+  return lo;
+}
+
+// gives the node arrays of G room for n vertices
+void dna_graph_reserve_nodes(dna_graph *G, size_t n){
+  if(n <= G->node_compacity) return;
+  size_t compacity = grow_compacity(G->node_compacity, n);
+  G->out_head = realloc(G->out_head, compacity * sizeof(size_t));
+  G->in_head = realloc(G->in_head, compacity * sizeof(size_t));
+  G->mark = realloc(G->mark, compacity * sizeof(unsigned char));
+  for(size_t v = G->node_compacity; v < compacity; v++){
+    G->out_head[v] = DNA_NO_EDGE;
+    G->in_head[v] = DNA_NO_EDGE;
+    G->mark[v] = 0;
   }
-  if(D->end->id < G->id){
-    D->end->next = G;
-    D->end = G;
-    return;
+  free(G->forward);
+  G->forward = malloc(3 * compacity * sizeof(priority_t));
+  G->backward = G->forward + compacity;
+  G->positions = G->backward + compacity;
+  free(G->moved);
+  G->moved = malloc(compacity * sizeof(vertex));
+  G->node_compacity = compacity;
+}
+
+void dna_graph_link(dna_graph *G, vertex start, vertex end){
+  dna_graph_reserve_nodes(G, (start > end ? start : end) + 1);
+  if(G->free_edges == DNA_NO_EDGE){
+    size_t compacity = grow_compacity(G->edge_compacity, G->edge_compacity + 1);
+    G->edge_start = realloc(G->edge_start, compacity * sizeof(vertex));
+    G->edge_end = realloc(G->edge_end, compacity * sizeof(vertex));
+    G->out_next = realloc(G->out_next, compacity * sizeof(size_t));
+    G->in_next = realloc(G->in_next, compacity * sizeof(size_t));
+    for(size_t e = G->edge_compacity; e < compacity; e++){
+      G->out_next[e] = e + 1 < compacity ? e + 1 : DNA_NO_EDGE;
+    }
+    G->free_edges = G->edge_compacity;
+    G->edge_compacity = compacity;
   }
-  gene *prev = D->start;
-  while(prev->next != NULL){
-    if(prev->next->id > G->id){
-      G->next = prev->next;
-      prev->next = G;
-      return;
+  size_t e = G->free_edges;
+  G->free_edges = G->out_next[e];
+  G->edge_start[e] = start;
+  G->edge_end[e] = end;
+  G->out_next[e] = G->out_head[start];
+  G->out_head[start] = e;
+  G->in_next[e] = G->in_head[end];
+  G->in_head[end] = e;
+}
+
+void dna_graph_unlink(dna_graph *G, vertex start, vertex end){
+  size_t *e = &G->out_head[start];
+  while(G->edge_end[*e] != end) e = &G->out_next[*e];
+  size_t edge = *e;
+  *e = G->out_next[edge];
+  e = &G->in_head[end];
+  while(*e != edge) e = &G->in_next[*e];
+  *e = G->in_next[edge];
+  G->out_next[edge] = G->free_edges;
+  G->free_edges = edge;
+}
+
+dna_graph *dna_graph_new(dna *D){
+  dna_graph *G = malloc(sizeof(dna_graph));
+  G->node_compacity = 0;
+  G->out_head = NULL;
+  G->in_head = NULL;
+  G->mark = NULL;
+  G->forward = NULL;
+  G->moved = NULL;
+  G->edge_compacity = 0;
+  G->edge_start = NULL;
+  G->edge_end = NULL;
+  G->out_next = NULL;
+  G->in_next = NULL;
+  G->free_edges = DNA_NO_EDGE;
+  dna_graph_reserve_nodes(G, D->size);
+  for(size_t i = 0; i < D->num_active_genes; i++){
+    size_t g = D->active_list[i];
+    dna_graph_link(G, D->start[g], D->end[g]);
+  }
+  return G;
+}
+
+void dna_graph_free(dna_graph *G){
+  free(G->out_head);
+  free(G->in_head);
+  free(G->mark);
+  free(G->forward);
+  free(G->moved);
+  free(G->edge_start);
+  free(G->edge_end);
+  free(G->out_next);
+  free(G->in_next);
+  free(G);
+}
+
+size_t dna_get_active_gene(dna *D, rng_t R){
+  return D->active_list[rng_below(R, D->num_active_genes)];
+}
+
+void dna_activate(dna *D, size_t g){
+  if(D->active[g]) return;
+  if(D->graph != NULL) dna_graph_link(D->graph, D->start[g], D->end[g]);
+  D->active[g] = true;
+  D->active_slot[g] = D->num_active_genes;
+  D->active_list[D->num_active_genes] = g;
+  D->num_active_genes++;
+}
+
+// the last active gene takes the place of g in the active list
+void dna_deactivate(dna *D, size_t g){
+  if(!D->active[g]) return;
+  if(D->graph != NULL) dna_graph_unlink(D->graph, D->start[g], D->end[g]);
+  D->active[g] = false;
+  D->num_active_genes--;
+  size_t last = D->active_list[D->num_active_genes];
+  D->active_list[D->active_slot[g]] = last;
+  D->active_slot[last] = D->active_slot[g];
+}
+
+bool dna_has_connection(dna *D, vertex start, vertex end){
+  uint64_t k = connection_key(start, end);
+  return D->connections[dna_find_connection(D->connections, D->connection_compacity, k)] == k;
+}
+
+// inserts an active gene in id order
+void dna_add_gene(dna *D, gene_id id, vertex start, vertex end, double weight){
+  dna_own_structure(D, D->num_genes + 1);
+  dna_reserve(D, D->num_genes + 1);
+  uint64_t k = connection_key(start, end);
+  D->connections[dna_find_connection(D->connections, D->connection_compacity, k)] = k;
+  size_t g = dna_upper_bound(D, id);
+  size_t n = D->num_genes - g;
+  memmove(D->weight + g + 1, D->weight + g, n * sizeof(double));
+  memmove(D->id + g + 1, D->id + g, n * sizeof(gene_id));
+  memmove(D->start + g + 1, D->start + g, n * sizeof(vertex));
+  memmove(D->end + g + 1, D->end + g, n * sizeof(vertex));
+  memmove(D->active + g + 1, D->active + g, n * sizeof(bool));
+  memmove(D->active_slot + g + 1, D->active_slot + g, n * sizeof(size_t));
+  // inserting in the middle shifts the genes after g, which costs as much as the moves above
+  if(n > 0){
+    for(size_t i = 0; i < D->num_active_genes; i++){
+      if(D->active_list[i] >= g) D->active_list[i]++;
     }
-    prev = prev->next;
   }
+  D->weight[g] = weight;
+  D->id[g] = id;
+  D->start[g] = start;
+  D->end[g] = end;
+  D->active[g] = false;
+  D->num_genes++;
+  dna_activate(D, g);
 }
 
-gene *dna_make_gene(dna *D, vertex start, vertex end, double weight, inovation_counter_t I){
-  gene *G = malloc(sizeof(gene));
-  G->start = start;
-  G->end = end;
-  G->weight = weight;
-  G->active = true;
-  G->next = NULL;
+gene_id dna_make_gene(vertex start, vertex end, inovation_counter_t I){
+  cgene C = {start, end};
+  return inovation_counter_get_or_add(I, C);
+}
 
-  key k = (key)gene_to_cgene(D, G);
-  gene_id *id = (gene_id *)inovation_counter_get(I, k);
-  if(id == NULL) {
-    G->id = inovation_counter_add(I, k);
+// moves the vertex with priority from to priority to, shifting the vertices in between by one
+void dna_move_priority(dna *D, priority_t from, priority_t to){
+  vertex v = D->order[from];
+  priority_t lo = from;
+  priority_t hi = to;
+  if(from < to){
+    memmove(D->order + from, D->order + from + 1, (to - from) * sizeof(vertex));
   } else{
-    G->id = *id;
-    free(k);
+    memmove(D->order + to + 1, D->order + to, (from - to) * sizeof(vertex));
+    lo = to;
+    hi = from;
+  }
+  D->order[to] = v;
+  for(priority_t p = lo; p <= hi; p++){
+    D->priority[D->order[p]] = p;
   }
-  return G;
 }
 
-priority_t dna_incr_priority(dna *D, vertex v, bool add){
-  vertex *k = malloc(sizeof(vertex));
-  *k = v;
-  priority_t *e = (priority_t *)dict_get(D->priority, (key) k);
-  priority_t p = *e;
-  
-  for(vertex i = 0; i < D->size; i++){
-    *k = i;
-    e = (priority_t *)dict_get(D->priority, (key) k);
-    if(*e >= p){
-      if(add) (*e)++;
-      else (*e)--;
+// collects the priorities of the nodes reachable from root along the edges out of (forward) or into
+// (!forward) each node, stopping at the window bound. Returns how many there are
+size_t dna_window_search(dna *D, vertex root, bool forward, priority_t bound, priority_t *found){
+  dna_graph *G = D->graph;
+  unsigned char mark = forward ? DNA_FORWARD : DNA_BACKWARD;
+  size_t n = 0;
+  G->mark[root] = mark;
+  found[n++] = D->priority[root];
+  for(size_t i = 0; i < n; i++){
+    vertex v = D->order[found[i]];
+    size_t e = forward ? G->out_head[v] : G->in_head[v];
+    while(e != DNA_NO_EDGE){
+      vertex w = forward ? G->edge_end[e] : G->edge_start[e];
+      priority_t p = D->priority[w];
+      if(G->mark[w] == 0 && (forward ? p <= bound : p >= bound)){
+        G->mark[w] = mark;
+        found[n++] = p;
+      }
+      e = forward ? G->out_next[e] : G->in_next[e];
     }
   }
-  free(k);
-  return p;
+  return n;
+}
+
+int priority_compare(const void *a, const void *b){
+  priority_t p1 = *(const priority_t *)a;
+  priority_t p2 = *(const priority_t *)b;
+  return (p1 > p2) - (p1 < p2);
+}
+
+// Pearce-Kelly: makes start come before end when it doesn't. Only the nodes between the two in the
+// evaluation order can be affected, so the searches are confined to that window: the nodes reachable from
+// end and the nodes reaching start within it swap places, each group keeping its internal order. Returns
+// false, changing nothing, if end reaches start so start -> end would close a cycle.
+bool dna_reorder(dna *D, vertex start, vertex end){
+  priority_t lo = D->priority[end];
+  priority_t hi = D->priority[start];
+  if(hi < lo) return true;
+  if(D->graph == NULL) D->graph = dna_graph_new(D);
+  dna_graph *G = D->graph;
+
+  size_t num_forward = dna_window_search(D, end, true, hi, G->forward);
+  if(G->mark[start] == DNA_FORWARD){
+    for(size_t i = 0; i < num_forward; i++) G->mark[D->order[G->forward[i]]] = 0;
+    return false;
+  }
+  size_t num_backward = dna_window_search(D, start, false, lo, G->backward);
+  qsort(G->forward, num_forward, sizeof(priority_t), &priority_compare);
+  qsort(G->backward, num_backward, sizeof(priority_t), &priority_compare);
+
+  // the affected positions, in order, are refilled with the nodes reaching start and then the nodes
+  // reachable from end
+  size_t n = 0;
+  for(size_t i = 0; i < num_backward; i++) G->moved[n++] = D->order[G->backward[i]];
+  for(size_t i = 0; i < num_forward; i++) G->moved[n++] = D->order[G->forward[i]];
+  size_t i = 0;
+  size_t j = 0;
+  for(size_t k = 0; k < n; k++){
+    if(j == num_forward || (i < num_backward && G->backward[i] < G->forward[j])) G->positions[k] = G->backward[i++];
+    else G->positions[k] = G->forward[j++];
+  }
+  dna_own_nodes(D, D->size);
+  for(size_t k = 0; k < n; k++){
+    D->order[G->positions[k]] = G->moved[k];
+    D->priority[G->moved[k]] = G->positions[k];
+    G->mark[G->moved[k]] = 0;
+  }
+  return true;
 }
 //end helper functions
 
 dna *dna_new(size_t input, size_t output){
-  dna *D = malloc(sizeof(dna));
-  D->start = NULL;
-  D->end = NULL;
-  D->num_active_genes = 0;
-  D->num_genes = 0;
-  D->size = input + output;
-  D->input = input;
-  D->output = output;
-  D->priority = dict_new(D->size*2, &vertex_hash, &vertex_equiv, &free, &free);
+  dna_structure *S = dna_structure_new(0, 16);
+  memset(S->connections, 0xff, S->connection_compacity * sizeof(uint64_t));
+  dna *D = dna_alloc(input, output, input + output, 0, S, dna_nodes_new(input + output));
   for(vertex i = 0; i < D->size; i++){
-    vertex *k = malloc(sizeof(vertex));
-    priority_t *e = malloc(sizeof(priority_t));
-    *k = i;
-    *e = i;
-    dict_add(D->priority, (key) k, (entry) e);
+    D->priority[i] = i;
+    D->order[i] = i;
   }
   return D;
 }
 
-void dna_add_connection(dna *D, inovation_counter_t I){
-  vertex start = rand() % (D->size - D->output);
+void dna_add_connection(dna *D, inovation_counter_t I, rng_t R){
+  vertex start = rng_below(R, D->size - D->output);
   vertex end = D->input;
   if(start >= D->input){
     if(start < D->input + D->output) start += D->output;
-    end += (rand() % (D->size - D->input - 1));
+    end += rng_below(R, D->size - D->input - 1);
     if(start == end) end = D->size - 1;
   } else{
-    end += (rand() % (D->size - D->input));
+    end += rng_below(R, D->size - D->input);
   }
-  if(dna_has_connection(D, start, end, I)) return;
-  
-  gene *G = dna_make_gene(D, start, end, ((double)rand() * 2.0 / (double)RAND_MAX) - 1.0, I);
+  if(dna_has_connection(D, start, end)) return;
+  // connections that would close a cycle are not added
+  if(!dna_reorder(D, start, end)) return;
   
-  dna_add_gene(D, G);
-
-  vertex *v1 = malloc(sizeof(vertex));
-  vertex *v2 = malloc(sizeof(vertex));
-  *v1 = start;
-  *v2 = end;
-  priority_t *p1 = (priority_t *)dict_get(D->priority, (key) v1);
-  priority_t *p2 = (priority_t *)dict_get(D->priority, (key) v2);
-
-  if(*p1 > *p2){
-    priority_t new_end = dna_incr_priority(D, start, true);
-    dna_incr_priority(D, end, false);
-    *p2 = new_end;
-  }
-
-  //Fix cycles
-  gene *fix = D->start;
-  while(fix != NULL){
-    *v1 = fix->start;
-    *v2 = fix->end;
-    priority_t *p1 = (priority_t *)dict_get(D->priority, (key) v1);
-    priority_t *p2 = (priority_t *)dict_get(D->priority, (key) v2);
-    if(*p1 > *p2){
-      fix->active = false;
-      D->num_active_genes--;
-    }
-    fix = fix->next;
-  }
-  
-  free(v1);
-  free(v2);
+  dna_add_gene(D, dna_make_gene(start, end, I), start, end, rng_uniform(R) * 2.0 - 1.0);
 }
 
-void dna_add_node(dna *D, inovation_counter_t I){
-  gene *G = dna_get_active_gene(D);
-  G->active = false;
-  D->num_active_genes--;
-  
-  gene *G1 = dna_make_gene(D, G->start, D->size, 1.0, I);
-  gene *G2 = dna_make_gene(D, D->size, G->end, G->weight, I);
+void dna_add_node(dna *D, inovation_counter_t I, rng_t R){
+  size_t g = dna_get_active_gene(D, R);
+  dna_deactivate(D, g);
+  // adding genes moves the split one
+  vertex start = D->start[g];
+  vertex split_end = D->end[g];
+  double weight = D->weight[g];
   
-  dna_add_gene(D, G1);
-  dna_add_gene(D, G2);
+  dna_add_gene(D, dna_make_gene(start, D->size, I), start, D->size, 1.0);
+  dna_add_gene(D, dna_make_gene(D->size, split_end, I), D->size, split_end, weight);
   
-  vertex *k = malloc(sizeof(vertex));
-  *k = D->size;
+  dna_own_nodes(D, D->size + 1);
 
-  priority_t *e = malloc(sizeof(priority_t));
-  vertex end = G->end;
+  // the new node goes just before the end of the split connection, or before every output
+  vertex end = split_end;
   if(end < D->input + D->output) end = D->input;
-  *e = dna_incr_priority(D, end, true);
-
-  dict_add(D->priority, (key) k, (entry) e);
+  D->priority[D->size] = D->size;
+  D->order[D->size] = D->size;
+  dna_move_priority(D, D->size, D->priority[end]);
   
   D->size++;
 }
 
-void dna_mutate_weight(dna *D){
-  gene *G = D->start;
-  double change = rand_norm();
+void dna_mutate_weight(dna *D, rng_t R){
+  // scaled to the spread of the sum of ten uniforms this used to be drawn as
+  double change = rng_norm(R) * 0.9128709291752769;
   if(fabs(change) < 0.001) change = 0.001;
-  while(G != NULL){
-    unsigned int mutation = rand() % 10;
+  for(size_t g = 0; g < D->num_genes; g++){
+    unsigned int mutation = rng_below(R, 10);
     if(mutation < 9){
-      G->weight += change;
-    } else G->weight = ((double)rand()) / ((double)RAND_MAX);
-    G = G->next;
+      D->weight[g] += change;
+    } else D->weight[g] = rng_uniform(R);
   }
 }
 
-void dna_mutate(dna *D, inovation_counter_t I){
+void dna_mutate(dna *D, inovation_counter_t I, rng_t R){
   if(D->num_active_genes == 0){
-    dna_add_connection(D, I);
-    dna_add_connection(D, I);
+    dna_add_connection(D, I, R);
+    dna_add_connection(D, I, R);
     return;
   }
-  if(rand() % 10 < 8) dna_mutate_weight(D);
-  if(rand() % 20 == 0) dna_add_connection(D, I);
-  if(rand() % 100 < 3) dna_add_node(D, I);
+  if(rng_below(R, 10) < 8) dna_mutate_weight(D, R);
+  if(rng_below(R, 20) == 0) dna_add_connection(D, I, R);
+  if(rng_below(R, 100) < 3) dna_add_node(D, I, R);
 }
 
-dna *dna_combine(dna *dom, dna *rec){
-  dna *D = malloc(sizeof(dna));
-  D->start = NULL;
-  D->end = NULL;
-  D->num_active_genes = 0;
-  D->num_genes = 0;
-  D->size = dom->size;
-  D->input = dom->input;
-  D->output = dom->output;
-  D->priority = dict_copy(dom->priority, &uint_copy, &uint_copy);
+void dna_number_genes(dna *D, gene_id first, inovation_counter_t I){
+  size_t tail = D->num_genes;
+  while(tail > 0 && D->id[tail - 1] >= first) tail--;
+  if(tail == D->num_genes) return;
+  dna_own_structure(D, D->num_genes);
+
+  // provisional IDs follow the order the genes were found in, so numbering the tail front to back
+  // matches adding each gene to I the moment it was found
+  for(size_t g = tail; g < D->num_genes; g++){
+    cgene C = {D->start[g], D->end[g]};
+    D->id[g] = inovation_counter_get_or_add(I, C);
+  }
+
+  // real IDs are all past those of the genes before the tail, so only the tail can be out of order
+  for(size_t g = tail + 1; g < D->num_genes; g++){
+    gene_id id = D->id[g];
+    vertex start = D->start[g];
+    vertex end = D->end[g];
+    double weight = D->weight[g];
+    bool active = D->active[g];
+    size_t active_slot = D->active_slot[g];
+    size_t h = g;
+    for(; h > tail && D->id[h - 1] > id; h--){
+      D->id[h] = D->id[h - 1];
+      D->start[h] = D->start[h - 1];
+      D->end[h] = D->end[h - 1];
+      D->weight[h] = D->weight[h - 1];
+      D->active[h] = D->active[h - 1];
+      D->active_slot[h] = D->active_slot[h - 1];
+    }
+    D->id[h] = id;
+    D->start[h] = start;
+    D->end[h] = end;
+    D->weight[h] = weight;
+    D->active[h] = active;
+    D->active_slot[h] = active_slot;
+  }
+  for(size_t g = tail; g < D->num_genes; g++){
+    if(D->active[g]) D->active_list[D->active_slot[g]] = g;
+  }
+}
+
+dna *dna_combine(dna *dom, dna *rec, rng_t R){
+  // the child has exactly the structure and node order of the dominant parent, so it shares them
+  atomic_fetch_add(&dom->structure->refs, 1);
+  atomic_fetch_add(&dom->nodes->refs, 1);
+  dna *D = dna_alloc(dom->input, dom->output, dom->size, dom->num_genes, dom->structure, dom->nodes);
+  dna_copy_genes(D, dom, dom->num_genes);
+  D->num_genes = dom->num_genes;
   
-  gene *G1 = dom->start;
-  gene *G2 = rec->start;
-  while(G1 != NULL){
-    gene *new_gene = gene_copy(G1);
-    
-    while(G2 != NULL && G2->id < G1->id) G2 = G2->next;
+  size_t g2 = 0;
+  for(size_t g = 0; g < D->num_genes; g++){
+    while(g2 < rec->num_genes && rec->id[g2] < D->id[g]) g2++;
     
-    if(G2 != NULL && G2->id == G1->id) {
-      if(rand() % 2 == 0) new_gene->weight = G2->weight;
-      if(!G1->active || !G2->active){
-        if(rand() % 4 == 0) new_gene->active = true;
-        else new_gene->active = false;
+    if(g2 < rec->num_genes && rec->id[g2] == D->id[g]) {
+      if(rng_below(R, 2) == 0) D->weight[g] = rec->weight[g2];
+      if(!D->active[g] || !rec->active[g2]){
+        // only connections pointing forward in the child's ordering can come back without closing a cycle
+        if(rng_below(R, 4) == 0) D->active[g] = D->priority[D->start[g]] < D->priority[D->end[g]];
+        else D->active[g] = false;
       }
     }
 
-    D->num_genes++;
-    if(new_gene->active) D->num_active_genes++;
-    
-    if(D->start == NULL) {
-      D->start = new_gene;
-      D->end = new_gene;
-    } else{
-      D->end->next = new_gene;
-      D->end = new_gene;
+    if(D->active[g]){
+      D->active_slot[g] = D->num_active_genes;
+      D->active_list[D->num_active_genes] = g;
+      D->num_active_genes++;
     }
-      
-    G1 = G1->next;
   }
   return D;
 }
 
 dna *dna_copy(dna *D){
-  dna *new_dna = malloc(sizeof(dna));
-  new_dna->input = D->input;
-  new_dna->output = D->output;
+  atomic_fetch_add(&D->structure->refs, 1);
+  atomic_fetch_add(&D->nodes->refs, 1);
+  dna *new_dna = dna_alloc(D->input, D->output, D->size, D->compacity, D->structure, D->nodes);
   new_dna->num_active_genes = D->num_active_genes;
   new_dna->num_genes = D->num_genes;
-  new_dna->size = D->size;
-  new_dna->priority = dict_copy(D->priority, &uint_copy, &uint_copy);
-  if(new_dna->num_genes == 0){
-    new_dna->start = NULL;
-    new_dna->end = NULL;
-    return new_dna;
-  }
-  new_dna->start = gene_copy(D->start);
-  new_dna->end = new_dna->start;
-  gene *G = D->start->next;
-  while(G != NULL){
-    new_dna->end->next = gene_copy(G);
-    new_dna->end = new_dna->end->next;
-    G = G->next;
-  }
+  // both blocks have the same layout, so the arrays copy over in one go
+  if(D->compacity > 0) memcpy(new_dna->genes, D->genes, gene_bytes(D->compacity));
   return new_dna;
 }
 
 network_t dna_to_network(dna *D, activation_fn *F){
-  network_t N = network_new(D->input, D->output, D->size, F);
-  gene *G = D->start;
-  vertex *start = malloc(sizeof(vertex));
-  vertex *end = malloc(sizeof(vertex));
-  while(G != NULL){
-    if(G->active) {
-      *start = G->start;
-      *end = G->end;
-      priority_t *pstart = (priority_t *)dict_get(D->priority, (key) start);
-      priority_t *pend = (priority_t *)dict_get(D->priority, (key) end);
-      network_add_connection(N, *pstart, *pend, G->weight);
+  // look up both ends of every live connection once, counting the connections leaving each node
+  vertex *src = malloc(D->num_genes * sizeof(vertex));
+  vertex *dst = malloc(D->num_genes * sizeof(vertex));
+  double *weight = malloc(D->num_genes * sizeof(double));
+  size_t *offset = calloc(D->size + 1, sizeof(size_t));
+  size_t num_edges = 0;
+  for(size_t g = 0; g < D->num_genes; g++){
+    if(D->active[g]) {
+      priority_t pstart = D->priority[D->start[g]];
+      priority_t pend = D->priority[D->end[g]];
+      // a connection pointing backwards in the ordering reaches its end node after that node has
+      // already been evaluated, so it never affects the output
+      if(pstart < pend){
+        src[num_edges] = pstart;
+        dst[num_edges] = pend;
+        weight[num_edges] = D->weight[g];
+        offset[pstart + 1]++;
+        num_edges++;
+      }
     }
-    G = G->next;
   }
-  free(start);
-  free(end);
+
+  // counting sort the connections by start node
+  for(size_t i = 0; i < D->size; i++){
+    offset[i + 1] += offset[i];
+  }
+  size_t *order = malloc(num_edges * sizeof(size_t));
+  for(size_t i = 0; i < num_edges; i++){
+    order[offset[src[i]]++] = i;
+  }
+
+  network_t N = network_new(D->input, D->output, D->size, num_edges, F);
+  for(size_t i = 0; i < num_edges; i++){
+    network_add_connection(N, src[order[i]], dst[order[i]], weight[order[i]]);
+  }
+  free(order);
+  free(offset);
+  free(src);
+  free(dst);
+  free(weight);
   return N;
 }
 
 inovation_counter_t dna_make_inovation_counter(size_t compacity){
-  return inovation_counter_new(compacity, &cgene_hash, &cgene_equiv, &free);
+  return inovation_counter_new(compacity);
 }
 
-double dna_distance(dna *D1, dna *D2, double c1, double c2, double c3){
+const gene_id *dna_get_inovations(dna *D, size_t *n){
+  *n = D->num_genes;
+  return D->id;
+}
+
+const bool *dna_get_activity(dna *D){
+  return D->active;
+}
+
+//helper functions
+
+// works out which genes of D's structure keep rejects and builds the structure without them
+dna_purge_plan dna_plan_purge(dna *D, gene_filter_fn *keep, void *arg){
+  dna_purge_plan plan = {NULL, NULL};
+  size_t kept = 0;
+  bool *drop = malloc(D->num_genes * sizeof(bool));
+  for(size_t g = 0; g < D->num_genes; g++){
+    drop[g] = !(*keep)(D->id[g], arg);
+    kept += !drop[g];
+  }
+  if(kept == D->num_genes){
+    free(drop);
+    return plan;
+  }
+
+  dna_structure *S = D->structure;
+  dna_structure *purged = dna_structure_new(S->compacity, S->connection_compacity);
+  memset(purged->connections, 0xff, S->connection_compacity * sizeof(uint64_t));
+  size_t j = 0;
+  for(size_t g = 0; g < D->num_genes; g++){
+    if(drop[g]) continue;
+    purged->id[j] = D->id[g];
+    purged->start[j] = D->start[g];
+    purged->end[j] = D->end[g];
+    uint64_t k = connection_key(D->start[g], D->end[g]);
+    purged->connections[dna_find_connection(purged->connections, purged->connection_compacity, k)] = k;
+    j++;
+  }
+  plan.purged = purged;
+  plan.drop = drop;
+  return plan;
+}
+
+// drops the genes marked in plan from D and moves D onto the purged structure
+void dna_apply_purge(dna *D, dna_purge_plan *plan){
+  size_t j = 0;
+  D->num_active_genes = 0;
+  for(size_t g = 0; g < D->num_genes; g++){
+    if(plan->drop[g]){
+      assert(!D->active[g]);
+      continue;
+    }
+    D->weight[j] = D->weight[g];
+    D->active[j] = D->active[g];
+    if(D->active[j]){
+      D->active_slot[j] = D->num_active_genes;
+      D->active_list[D->num_active_genes] = j;
+      D->num_active_genes++;
+    }
+    j++;
+  }
+  D->num_genes = j;
+  atomic_fetch_add(&plan->purged->refs, 1);
+  dna_release_structure(D->structure);
+  dna_attach_structure(D, plan->purged);
+}
+//end helper functions
+
+void dna_purge(dna **genomes, size_t n, gene_filter_fn *keep, void *arg){
+  purge_dict plans;
+  purge_dict_init(&plans, n);
+  for(size_t i = 0; i < n; i++){
+    dna *D = genomes[i];
+    dna_purge_plan *plan = purge_dict_get(&plans, D->structure);
+    if(plan == NULL){
+      // the plan holds a reference so the old structure can't be freed and its address reused while the
+      // dictionary is keyed on it
+      atomic_fetch_add(&D->structure->refs, 1);
+      plan = purge_dict_add(&plans, D->structure, dna_plan_purge(D, keep, arg));
+    }
+    if(plan->purged != NULL) dna_apply_purge(D, plan);
+  }
+
+  size_t i = 0;
+  dna_structure *S;
+  dna_purge_plan plan;
+  while(purge_dict_next(&plans, &i, &S, &plan)){
+    dna_release_structure(S);
+    if(plan.purged == NULL) continue;
+    dna_release_structure(plan.purged);
+    free(plan.drop);
+  }
+  purge_dict_free(&plans);
+}
+
+//helper functions
+
+// matching genes are compared in blocks of this many so a distance can stop early inside a long shared run
+#define DNA_DISTANCE_BLOCK 64
+
+// the number of leading positions, up to n, at which a and b hold the same id
+size_t dna_matching_run(const gene_id *a, const gene_id *b, size_t n){
+  // copies sharing a structure share the id array too
+  if(a == b) return n;
+  size_t i = 0;
+#ifdef __SSE2__
+  for(; i + 4 <= n; i += 4){
+    __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi32(x, y)) != 0xffff) break;
+  }
+#endif
+  while(i < n && a[i] == b[i]) i++;
+  return i;
+}
+
+// the sum of |w1[i] - w2[i]| for i < n, added up in two interleaved lanes so the vector and scalar
+// versions give exactly the same result
+double dna_weight_difference(const double *w1, const double *w2, size_t n){
+  size_t i = 0;
+  double even = 0;
+  double odd = 0;
+#ifdef __SSE2__
+  __m128d sum = _mm_setzero_pd();
+  __m128d sign = _mm_set1_pd(-0.0);
+  for(; i + 2 <= n; i += 2){
+    __m128d d = _mm_sub_pd(_mm_loadu_pd(w1 + i), _mm_loadu_pd(w2 + i));
+    sum = _mm_add_pd(sum, _mm_andnot_pd(sign, d));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, sum);
+  even = lanes[0];
+  odd = lanes[1];
+#else
+  for(; i + 2 <= n; i += 2){
+    even += fabs(w1[i] - w2[i]);
+    odd += fabs(w1[i + 1] - w2[i + 1]);
+  }
+#endif
+  if(i < n) even += fabs(w1[i] - w2[i]);
+  return even + odd;
+}
+//end helper functions
+
+double dna_distance_bounded(dna *D1, dna *D2, double c1, double c2, double c3, double thresh){
+  size_t n1 = D1->num_genes;
+  size_t n2 = D2->num_genes;
+  double num = (double)min(n1, n2);
+  // the genes one strand has beyond the length of the other are disjoint or excess whatever their ids
+  if(num > 0){
+    double bound = (c1 < c2 ? c1 : c2) * ((double)(n1 > n2 ? n1 - n2 : n2 - n1)) / num;
+    if(bound >= thresh) return bound;
+  }
+
   size_t dis = 0;
   size_t exc = 0;
   double weight = 0;
-  double num = (double)min(D1->num_genes, D2->num_genes);
-  gene *G1 = D1->start;
-  gene *G2 = D2->start;
-  while(G1 != NULL || G2 != NULL){
-    if(G1 == NULL){
-      exc++;
-      G2 = G2->next;
-    } else if(G2 == NULL){
-      exc++;
-      G1 = G1->next;
-    } else if(G1->id == G2->id){
-      weight += fabs(G1->weight - G2->weight);
-      G1 = G1->next;
-      G2 = G2->next;
-    } else if(G1->id < G2->id){
+  size_t g1 = 0;
+  size_t g2 = 0;
+  while(g1 < n1 && g2 < n2){
+    size_t run = dna_matching_run(D1->id + g1, D2->id + g2, min(min(n1 - g1, n2 - g2), DNA_DISTANCE_BLOCK));
+    if(run > 0){
+      weight += dna_weight_difference(D1->weight + g1, D2->weight + g2, run);
+      g1 += run;
+      g2 += run;
+    } else if(D1->id[g1] < D2->id[g2]){
       dis++;
-      G1 = G1->next;
+      g1++;
     } else{
       dis++;
-      G2 = G2->next;
+      g2++;
     }
+    // every term only grows from here, so this is already a lower bound on the distance
+    double partial = c1*((double)dis)/num + c3*weight;
+    if(partial >= thresh) return partial;
   }
+  // whatever is left of the longer strand is excess
+  exc += (n1 - g1) + (n2 - g2);
   return c1*((double)dis)/num + c2*((double)exc)/num + c3*weight;
 }
 
+double dna_distance(dna *D1, dna *D2, double c1, double c2, double c3){
+  return dna_distance_bounded(D1, D2, c1, c2, c3, INFINITY);
+}
+
 void dna_print(dna *D){
-  gene *G = D->start;
-  while(G != NULL){
-    printf("gene %d: %d -> %d\t\tActive: %d\t\tWeight: %f\n", G->id, G->start, G->end, G->active ? 1 : 0, G->weight);
-    G = G->next;
+  for(size_t g = 0; g < D->num_genes; g++){
+    printf("gene %d: %d -> %d\t\tActive: %d\t\tWeight: %f\n", D->id[g], D->start[g], D->end[g], D->active[g] ? 1 : 0, D->weight[g]);
   }
 }
 
 void dna_free(dna *D){
-  gene *G = D->start;
-  while(G != NULL){
-    gene *next = G->next;
-    free(G);
-    G = next;
-  }
-  dict_free(D->priority);
+  if(D->graph != NULL) dna_graph_free(D->graph);
+  free(D->genes);
+  dna_release_structure(D->structure);
+  dna_release_nodes(D->nodes);
   free(D);
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 /*
     This is the representation of the NEAT networks DNA so that it can be mutated. DNA is designed
-    as a linked list of "genes" which can be active or inactive. These genes all represent the connection
+    as an array of "genes", sorted by inovation number, which can be active or inactive. These genes all represent the connection
     between two nodes and the weight of the connection. The DNA keeps track of the number of active genes
     and the number of dependencies of each gene. It also keeps track of the number of input nodes and the number of output nodes.
  */
@@ -9,6 +9,7 @@
 
 #include "network.h"
 #include "inovation_counter.h"
+#include "rng.h"
 
 typedef struct dna_header *dna_t;
 
@@ -25,44 +26,71 @@ dna_t dna_new(size_t input, size_t output);
  * @brief creates a new random connection between two nodes in the network
  * @param D the DNA to add the connection gene to
  * @param I the inovation counter to assign the new gene a unique ID so that it can be tracked for reproduction
+ * @param R the random number generator to draw from
  */
-//Precondition: D != NULL and I != NULL
-void dna_add_connection(dna_t D, inovation_counter_t I);
+//Precondition: D != NULL, I != NULL, and R != NULL
+void dna_add_connection(dna_t D, inovation_counter_t I, rng_t R);
 
 /**
  * @brief splits a random connection to create a new node (A -> B becomes A -> C -> B)
  * @param D the DNA to add the node to
  * @param I the inocation counter to assign the new gene a unique ID for reproduction purposes
+ * @param R the random number generator to draw from
  */
-//Precondition: D != NULL and I != NULL
-void dna_add_node(dna_t D, inovation_counter_t I);
+//Precondition: D != NULL, I != NULL, and R != NULL
+void dna_add_node(dna_t D, inovation_counter_t I, rng_t R);
 
 /**
  * @brief randomly alters the weight of a random connection
  * @param D the DNA to mutate
+ * @param R the random number generator to draw from
  */
-//Precondition: D != NULL
-void dna_mutate_weight(dna_t D);
+//Precondition: D != NULL and R != NULL
+void dna_mutate_weight(dna_t D, rng_t R);
 
 /**
  * @brief picks a random type of mutation and applies it to the DNA
  * @param D the dna to mutate
  * @param I the inovation counter to keep track of new genes
+ * @param R the random number generator to draw from
+ */
+//Precondition: D != NULL, I != NULL, and R != NULL
+void dna_mutate(dna_t D, inovation_counter_t I, rng_t R);
+
+/**
+ * @brief gives the genes of a strand of DNA that have provisional IDs their real IDs
+ * 
+ * The genes with IDs from first up are looked up in I, or added to it in the order their provisional IDs
+ * were given out, then moved to keep the genes sorted by ID. This is how genes found through a counter
+ * made by inovation_counter_new_deferred are published once the order of the strands is known.
+ * 
+ * @param D the dna to number
+ * @param first the first provisional ID, every gene of D with a smaller ID already has its real ID
+ * @param I the inovation counter to take real IDs from
  */
-//Precondition: D != NULL and I != NULL
-void dna_mutate(dna_t D, inovation_counter_t I);
+//Precondition: D != NULL, I != NULL, and none of the genes of D with IDs from first up were in I when
+//inovation_counter_get_next(I) was first
+void dna_number_genes(dna_t D, gene_id first, inovation_counter_t I);
 
 /**
  * @brief combines to strands of DNA into one "child"
+ * 
+ * The child shares the gene structure of the dominant parent the same way dna_copy does.
+ * 
  * @param dom the dominant parent's DNA
  * @param rec the recesive parent's DNA
+ * @param R the random number generator to draw from
  */
-//Precondition: dom != NULL and rec != NULL
+//Precondition: dom != NULL, rec != NULL, and R != NULL
 //Postcondition: Result is not NULL
-dna_t dna_combine(dna_t dom, dna_t rec);
+dna_t dna_combine(dna_t dom, dna_t rec, rng_t R);
 
 /**
- * @brief makes a deep copy of a strand of DNA
+ * @brief makes a copy of a strand of DNA
+ * 
+ * The copy shares the gene structure and node order of D until either of them changes it, so copying
+ * only duplicates the weights and which genes are active. The two can be mutated and freed independently.
+ * 
  * @param D the DNA to copy
  */
 //Precondition: D != NULL
@@ -85,6 +113,43 @@ network_t dna_to_network(dna_t D, activation_fn *F);
 //Postcondition: Result is not NULL
 inovation_counter_t dna_make_inovation_counter(size_t compacity);
 
+/**
+ * @brief returns the IDs of every gene in a strand of DNA, active or not, in increasing order
+ * 
+ * The array belongs to D and may be shared with its copies. It is only valid until D is next changed or
+ * freed.
+ * 
+ * @param D the DNA to read
+ * @param n where to write the number of genes
+ */
+//Precondition: D != NULL and n != NULL
+const gene_id *dna_get_inovations(dna_t D, size_t *n);
+
+/**
+ * @brief returns which genes of a strand of DNA are active
+ * 
+ * Result[g] is whether the gene with ID dna_get_inovations(D, &n)[g] is active. The array is only valid
+ * until D is next changed or freed.
+ * 
+ * @param D the DNA to read
+ */
+//Precondition: D != NULL
+const bool *dna_get_activity(dna_t D);
+
+/**
+ * @brief removes inactive genes from several strands of DNA at once
+ * 
+ * Every gene whose ID keep rejects is dropped from every strand carrying it, so genes of different strands
+ * with the same ID still line up afterwards. Strands that shared their gene structure before still share it.
+ * 
+ * @param genomes the DNA to purge
+ * @param n the number of strands
+ * @param keep returns whether a gene stays
+ * @param arg the argument passed to every call of keep
+ */
+//Precondition: genomes != NULL, keep != NULL, and keep accepts every gene active in any of the genomes
+void dna_purge(dna_t *genomes, size_t n, gene_filter_fn *keep, void *arg);
+
 /**
  * @brief determines how closely related two strands of DNA are
  * @param D1 the first DNA to compare
@@ -96,6 +161,24 @@ inovation_counter_t dna_make_inovation_counter(size_t compacity);
 //Precondition: D1 != NULL and D2 != NULL
 double dna_distance(dna_t D1, dna_t D2, double c1, double c2, double c3);
 
+/**
+ * @brief determines how closely related two strands of DNA are, giving up once they are known to be at
+ * least thresh apart
+ * 
+ * Comparing against a threshold is all speciation needs, and most pairs of strands of different species
+ * are told apart long before the end of the shorter one.
+ * 
+ * @param D1 the first DNA to compare
+ * @param D2 the second DNA to compare
+ * @param c1 the weight on the number of distinct genes
+ * @param c2 the weight on the number of excess genes
+ * @param c3 the weight on the difference in weights of shared genes
+ * @param thresh the distance at which to stop
+ */
+//Precondition: D1 != NULL, D2 != NULL, and c1, c2 and c3 >= 0
+//Postcondition: Result is dna_distance(D1, D2, c1, c2, c3) if that is < thresh, otherwise Result >= thresh
+double dna_distance_bounded(dna_t D1, dna_t D2, double c1, double c2, double c3, double thresh);
+
 /**
  * @brief prints DNA
  * @param D the DNA to print
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
+#include "network.h"
+#include "activation.h"
+
+//helper functions
+
+#define EXPORT_STRING(...) #__VA_ARGS__
+#define EXPORT_SOURCE(...) EXPORT_STRING(__VA_ARGS__)
+
+// writes activation_exp under the name name_exp, from the same macro activation.h builds it from, so the
+// exported activations round exactly like the ones network_calc uses
+void export_exp(const char *name, FILE *out){
+  // stringizing runs the body together on one line, so each statement is put back on its own
+  const char *body = EXPORT_SOURCE(ACTIVATION_EXP_BODY);
+  fprintf(out, "static double %s_exp(double x){\n  ", name);
+  for(const char *c = body; *c != '\0'; c++){
+    if(*c == ' ' && c > body && c[-1] == ';') fputs("\n  ", out);
+    else fputc(*c, out);
+  }
+  fprintf(out, "\n}\n\n");
+}
+
+// writes a weight so that it reads back as the same double, including infinities and NaN
+void export_weight(double weight, FILE *out){
+  if(isnan(weight)) fprintf(out, "NAN");
+  else if(isinf(weight)) fprintf(out, weight > 0.0 ? "INFINITY" : "-INFINITY");
+  else fprintf(out, "%.17g", weight);
+}
+
+// writes the definition of the activation the generated code calls as name_activation
+void export_activation(activation_kind kind, const char *name, FILE *out){
+  switch(kind){
+    case ACTIVATION_IDENTITY:
+      break;
+    case ACTIVATION_SIGMOID:
+      export_exp(name, out);
+      fprintf(out, "static double %s_activation(double x){\n  return 1.0 / (1.0 + %s_exp(-4.9 * x));\n}\n\n", name, name);
+      break;
+    case ACTIVATION_SIGNED_SIGMOID:
+      export_exp(name, out);
+      fprintf(out, "static double %s_activation(double x){\n  return 2.0 / (1.0 + %s_exp(-4.9 * x)) - 1.0;\n}\n\n", name, name);
+      break;
+    case ACTIVATION_TANH:
+      export_exp(name, out);
+      fprintf(out, "static double %s_activation(double x){\n  return 1.0 - 2.0 / (1.0 + %s_exp(2.0 * x));\n}\n\n", name, name);
+      break;
+    case ACTIVATION_RELU:
+      fprintf(out, "static double %s_activation(double x){\n  return x > 0.0 ? x : 0.0;\n}\n\n", name);
+      break;
+    default:
+      fprintf(out, "extern double %s_activation(double x);\n\n", name);
+      break;
+  }
+}
+//end helper functions
+
+int network_export_c(network_t N, const char *name, FILE *out){
+  size_t input = network_get_input(N);
+  size_t output = network_get_output(N);
+  size_t size = network_get_size(N);
+  size_t num_edges = network_get_num_edges(N);
+  activation_kind kind = network_get_activation_kind(N);
+  bool identity = kind == ACTIVATION_IDENTITY;
+
+  // a connection matters if its end reaches an output; connections are in evaluation order, so one pass
+  // backwards sees every connection leaving a node before deciding whether the node itself is needed
+  bool *live = calloc(size, sizeof(bool));
+  bool *edge_live = malloc(num_edges * sizeof(bool));
+  for(size_t i = size - output; i < size; i++) live[i] = true;
+  for(size_t i = num_edges; i > 0; i--){
+    vertex start, end;
+    double weight;
+    network_get_edge(N, i - 1, &start, &end, &weight);
+    edge_live[i - 1] = live[end];
+    if(live[end]) live[start] = true;
+  }
+
+  fprintf(out, "/* generated from a network with %zu inputs, %zu outputs, %zu nodes and %zu connections */\n",
+          input, output, size, num_edges);
+  fprintf(out, "#include <stdint.h>\n#include <string.h>\n#include <math.h>\n\n");
+  export_activation(kind, name, out);
+  fprintf(out, "void %s(const double *input, double *output){\n", name);
+  for(size_t i = 0; i < input; i++){
+    if(live[i]) fprintf(out, "  double v%zu = input[%zu];\n", i, i);
+  }
+  for(size_t i = input; i < size; i++){
+    if(live[i]) fprintf(out, "  double v%zu = 0.0;\n", i);
+  }
+  for(size_t i = 0; i < num_edges; i++){
+    if(!edge_live[i]) continue;
+    vertex start, end;
+    double weight;
+    network_get_edge(N, i, &start, &end, &weight);
+    if(identity) fprintf(out, "  v%u += ", end);
+    else fprintf(out, "  v%u += %s_activation(", end, name);
+    export_weight(weight, out);
+    fprintf(out, identity ? " * v%u;\n" : " * v%u);\n", start);
+  }
+  for(size_t i = 0; i < output; i++){
+    if(identity) fprintf(out, "  output[%zu] = v%zu;\n", i, size - output + i);
+    else fprintf(out, "  output[%zu] = %s_activation(v%zu);\n", i, name, size - output + i);
+  }
+  fprintf(out, "}\n");
+
+  free(live);
+  free(edge_live);
+  return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,29 @@
+/**
+ * Exports a finished network as C source. The generated function hard-codes every weight and performs
+ * the connections as straight-line code in evaluation order, so a champion can be compiled straight into
+ * a service instead of running through network_calc. Connections that can't reach an output are left out.
+ */
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdio.h>
+#include "network.h"
+
+/**
+ * @brief writes a C function evaluating a network
+ * 
+ * The function is written as void name(const double *input, double *output) and only depends on
+ * stdint.h, string.h and math.h. Built-in activations are emitted with the same exp approximation network_calc
+ * uses, so compiled with the same floating point options the function returns exactly what network_calc
+ * does. Networks with a custom activation call an extern double name_activation(double) that the
+ * including program must define.
+ * 
+ * @param N the network to export
+ * @param name the name of the generated function, which must be a valid C identifier
+ * @param out the file to write the source to
+ */
+//Precondition: N != NULL, name != NULL, and out != NULL
+//Postcondition: Result is 0 on success and -1 if writing to out failed
+int network_export_c(network_t N, const char *name, FILE *out);
+
+#endif // EXPORT_H
@@ -1,37 +1,204 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "dict.h"
+#include "network.h"
 
 typedef unsigned int gene_id;
+typedef bool gene_filter_fn(gene_id id, void *arg);
 
-struct inovation_counter_header{
-  gene_id counter;
-  dict_t D;
+struct cgene_header{
+  vertex start;
+  vertex end;
+};
+typedef struct cgene_header cgene;
+
+#define CGENE_HASH(k) (65537u * (k).start + (k).end)
+#define CGENE_EQUIV(k1, k2) ((k1).start == (k2).start && (k1).end == (k2).end)
+DICT_DEFINE(cgene_dict, cgene, gene_id, CGENE_HASH, CGENE_EQUIV)
+
+// genes are spread over independently locked shards so threads discovering different genes don't wait
+// on each other, while IDs come from one atomic counter
+#define INOVATION_COUNTER_SHARD_BITS 6
+#define INOVATION_COUNTER_SHARDS (1 << INOVATION_COUNTER_SHARD_BITS)
+
+struct shard_header{
+  pthread_rwlock_t lock;
+  cgene_dict D;
 };
+typedef struct shard_header shard;
+
 typedef struct inovation_counter_header inovation_counter;
+struct inovation_counter_header{
+  atomic_uint counter;
+  shard shards[INOVATION_COUNTER_SHARDS];
+  inovation_counter *parent; // the counter a deferred counter reads through to, NULL otherwise
+  gene_id first; // added to every ID given out, so provisional IDs start past those of the parent
+};
 
-inovation_counter *inovation_counter_new(size_t compacity, key_hash_fn *hash, key_equiv_fn *equiv, key_free_fn key_free){
+inovation_counter *inovation_counter_new(size_t compacity){
   inovation_counter *I = malloc(sizeof(inovation_counter));
-  I->counter = 0;
-  I->D = dict_new(compacity, hash, equiv, key_free, &free);
+  atomic_init(&I->counter, 0);
+  size_t shard_compacity = compacity / INOVATION_COUNTER_SHARDS + 1;
+  for(size_t i = 0; i < INOVATION_COUNTER_SHARDS; i++){
+    pthread_rwlock_init(&I->shards[i].lock, NULL);
+    cgene_dict_init(&I->shards[i].D, shard_compacity);
+  }
+  I->parent = NULL;
+  I->first = 0;
   return I;
 }
 
-gene_id inovation_counter_add(inovation_counter *I, key k){
-  gene_id *id = malloc(sizeof(gene_id));
-  *id = I->counter;
-  I->counter++;
-  dict_add(I->D, k, (entry)id);
-  return *id;
+inovation_counter *inovation_counter_new_deferred(inovation_counter *I){
+  inovation_counter *D = inovation_counter_new(0);
+  D->parent = I;
+  D->first = atomic_load(&I->counter);
+  return D;
+}
+
+//helper functions
+
+// uses the high bits of a multiplicative hash so the shard doesn't correlate with the slot in the shard
+shard *inovation_counter_shard(inovation_counter *I, cgene k){
+  unsigned int h = CGENE_HASH(k) * 2654435769u;
+  return &I->shards[h >> (32 - INOVATION_COUNTER_SHARD_BITS)];
+}
+
+// must hold the write lock of S
+gene_id shard_insert(inovation_counter *I, shard *S, cgene k){
+  gene_id id = I->first + atomic_fetch_add(&I->counter, 1);
+  cgene_dict_add(&S->D, k, id);
+  return id;
+}
+
+// looks a gene up in the counter's own shards
+bool shard_get(inovation_counter *I, cgene k, gene_id *id){
+  shard *S = inovation_counter_shard(I, k);
+  pthread_rwlock_rdlock(&S->lock);
+  gene_id *found = cgene_dict_get(&S->D, k);
+  if(found != NULL) *id = *found;
+  pthread_rwlock_unlock(&S->lock);
+  return found != NULL;
+}
+
+// looks a gene up in the counter a deferred counter reads through to
+bool parent_get(inovation_counter *I, cgene k, gene_id *id){
+  return I->parent != NULL && shard_get(I->parent, k, id);
 }
+//end helper functions
 
-entry inovation_counter_get(inovation_counter *I, key k){
-  return dict_get(I->D, k);
+gene_id inovation_counter_add(inovation_counter *I, cgene k){
+  gene_id id;
+  if(parent_get(I, k, &id)) return id;
+  shard *S = inovation_counter_shard(I, k);
+  pthread_rwlock_wrlock(&S->lock);
+  id = shard_insert(I, S, k);
+  pthread_rwlock_unlock(&S->lock);
+  return id;
 }
 
-entry inovation_counter_remove(inovation_counter *I, key k){
-  return dict_remove(I->D, k);
+gene_id inovation_counter_get_or_add(inovation_counter *I, cgene k){
+  gene_id id;
+  if(parent_get(I, k, &id)) return id;
+  shard *S = inovation_counter_shard(I, k);
+
+  // nearly every lookup finds an existing gene, so try under the shared lock first
+  pthread_rwlock_rdlock(&S->lock);
+  gene_id *found = cgene_dict_get(&S->D, k);
+  id = found == NULL ? 0 : *found;
+  pthread_rwlock_unlock(&S->lock);
+  if(found != NULL) return id;
+
+  pthread_rwlock_wrlock(&S->lock);
+  found = cgene_dict_get(&S->D, k);
+  if(found == NULL) id = shard_insert(I, S, k);
+  else id = *found;
+  pthread_rwlock_unlock(&S->lock);
+  return id;
+}
+
+bool inovation_counter_get(inovation_counter *I, cgene k, gene_id *id){
+  return parent_get(I, k, id) || shard_get(I, k, id);
+}
+
+bool inovation_counter_remove(inovation_counter *I, cgene k){
+  shard *S = inovation_counter_shard(I, k);
+  pthread_rwlock_wrlock(&S->lock);
+  bool removed = cgene_dict_remove(&S->D, k);
+  pthread_rwlock_unlock(&S->lock);
+  return removed;
+}
+
+size_t inovation_counter_retain(inovation_counter *I, gene_filter_fn *keep, void *arg){
+  size_t removed = 0;
+  for(size_t i = 0; i < INOVATION_COUNTER_SHARDS; i++){
+    shard *S = &I->shards[i];
+    pthread_rwlock_wrlock(&S->lock);
+    // rebuilding rather than removing in place lets the table shrink back down after a burst of new genes
+    cgene_dict old = S->D;
+    size_t kept = 0;
+    size_t j = 0;
+    gene_id id;
+    while(cgene_dict_next(&old, &j, NULL, &id)) kept += (*keep)(id, arg);
+    cgene_dict_init(&S->D, 2 * kept);
+    j = 0;
+    cgene k;
+    while(cgene_dict_next(&old, &j, &k, &id)){
+      if((*keep)(id, arg)) cgene_dict_add(&S->D, k, id);
+    }
+    removed += cgene_dict_size(&old) - kept;
+    cgene_dict_free(&old);
+    pthread_rwlock_unlock(&S->lock);
+  }
+  return removed;
+}
+
+void inovation_counter_clear(inovation_counter *I){
+  // a deferred counter is cleared once per genome and rarely has anything to clear
+  if(I->parent != NULL && atomic_load(&I->counter) == 0){
+    I->first = atomic_load(&I->parent->counter);
+    return;
+  }
+  for(size_t i = 0; i < INOVATION_COUNTER_SHARDS; i++){
+    pthread_rwlock_wrlock(&I->shards[i].lock);
+    cgene_dict_clear(&I->shards[i].D);
+    pthread_rwlock_unlock(&I->shards[i].lock);
+  }
+  if(I->parent != NULL){
+    atomic_store(&I->counter, 0);
+    I->first = atomic_load(&I->parent->counter);
+  }
+}
+
+gene_id inovation_counter_get_next(inovation_counter *I){
+  return I->first + atomic_load(&I->counter);
+}
+
+size_t inovation_counter_get_size(inovation_counter *I){
+  size_t size = 0;
+  for(size_t i = 0; i < INOVATION_COUNTER_SHARDS; i++){
+    pthread_rwlock_rdlock(&I->shards[i].lock);
+    size += cgene_dict_size(&I->shards[i].D);
+    pthread_rwlock_unlock(&I->shards[i].lock);
+  }
+  return size;
+}
+
+size_t inovation_counter_get_bytes(inovation_counter *I){
+  size_t bytes = sizeof(inovation_counter);
+  for(size_t i = 0; i < INOVATION_COUNTER_SHARDS; i++){
+    pthread_rwlock_rdlock(&I->shards[i].lock);
+    bytes += cgene_dict_bytes(&I->shards[i].D);
+    pthread_rwlock_unlock(&I->shards[i].lock);
+  }
+  return bytes;
 }
 
 void inovation_counter_free(inovation_counter *I){
-  dict_free(I->D);
+  for(size_t i = 0; i < INOVATION_COUNTER_SHARDS; i++){
+    cgene_dict_free(&I->shards[i].D);
+    pthread_rwlock_destroy(&I->shards[i].lock);
+  }
   free(I);
-}
\ No newline at end of file
+}
@@ -1,62 +1,151 @@
 /**
  * The inovation counter tracks the different genes that show up across multiple iterations of NEAT.
  * Each new gene is assigned a unique ID and added to a dictionary.
+ * 
+ * All operations are safe to call from multiple threads at once. Keys are split across shards that are
+ * locked independently and lookups of existing genes only take a shared lock, so parallel mutation
+ * doesn't serialize on the counter.
  */
 #ifndef INOVATION_COUNTER_H
 #define INOVATION_COUNTER_H
 
-#include "dict.h"
+#include <stdbool.h>
+#include "network.h"
 
 typedef unsigned int gene_id;
 
+// a connection gene as the counter knows it, by the nodes it connects
+struct cgene_header{
+  vertex start;
+  vertex end;
+};
+typedef struct cgene_header cgene;
+
 typedef struct inovation_counter_header *inovation_counter_t;
 
 /**
  * @brief creates a new inovation counter
  * @param compacity the initial size of the counter
- * @param hash the hash function for the genes
- * @param equiv the equivalence function for the genes
- * @param key_free the free function for genes
  */
-//Precondition: hash != NULL and equiv != NULL
 //Postcondition: Result is not NULL
-inovation_counter_t inovation_counter_new(size_t compacity, key_hash_fn *hash, key_equiv_fn *equiv, key_free_fn key_free);
+inovation_counter_t inovation_counter_new(size_t compacity);
 
 /**
- * @brief gets the ID of a given key
- * @param I the counter to get the ID from
- * @param k the key to get the ID of
+ * @brief creates a counter that looks genes up in I but never adds to it
+ * 
+ * Genes already in I keep their IDs. Genes new to I get provisional IDs counting up from
+ * inovation_counter_get_next(I), so they can be told apart from every gene of I and later given real IDs
+ * in an order of the caller's choosing. This lets threads discover genes in parallel while the IDs the
+ * genes end up with only depend on that order. Unlike other counters, a deferred counter must only be
+ * used by one thread at a time, and I must not be added to while it is in use.
+ * 
+ * @param I the counter to read through to
+ */
+//Precondition: I != NULL and I is not deferred
+//Postcondition: Result is not NULL
+inovation_counter_t inovation_counter_new_deferred(inovation_counter_t I);
+
+/**
+ * @brief returns the ID the counter gives the next gene added to it
+ * @param I the counter to query
  */
 //Precondition: I != NULL
-entry inovation_counter_get(inovation_counter_t I, key k);
+gene_id inovation_counter_get_next(inovation_counter_t I);
+
+/**
+ * @brief gets the ID of a given gene
+ * @param I the counter to get the ID from
+ * @param k the gene to get the ID of
+ * @param id where to write the ID if the gene is in the counter
+ */
+//Precondition: I != NULL and id != NULL
+//Postcondition: Result is true if the gene is in the counter
+bool inovation_counter_get(inovation_counter_t I, cgene k, gene_id *id);
 
 /**
- * @brief adds a key to the counter with a new ID
+ * @brief adds a gene to the counter with a new ID
  * @param I the counter to add to
- * @param k the key to add
+ * @param k the gene to add
+ */
+//Precondition: I != NULL
+//Postcondition: inovation_counter_get(I, k, &id) is true
+gene_id inovation_counter_add(inovation_counter_t I, cgene k);
+
+/**
+ * @brief returns the ID of a gene, adding it with a new ID if it is not in the counter yet
+ * 
+ * The lookup and the insertion happen as one step, so threads racing to add the same gene all get the
+ * same ID.
+ * 
+ * @param I the counter to search and add to
+ * @param k the gene to get the ID of
  */
 //Precondition: I != NULL
-//Postcondition: inovation_counter_get(I, k) != NULL
-gene_id inovation_counter_add(inovation_counter_t I, key k);
+//Postcondition: inovation_counter_get(I, k, &id) is true
+gene_id inovation_counter_get_or_add(inovation_counter_t I, cgene k);
 
 /**
- * @brief removes a key from the counter
+ * @brief removes a gene from the counter
  * @param I the counter to remove from
- * @param k the key to remove
+ * @param k the gene to remove
+ */
+//Precondition: I != NULL
+//Postcondition: inovation_counter_get(I, k, &id) is false, and Result is whether k was in the counter
+bool inovation_counter_remove(inovation_counter_t I, cgene k);
+
+/**
+ * @brief decides whether a gene is kept by inovation_counter_retain
+ * @param id the ID of the gene
+ * @param arg the argument given to inovation_counter_retain
+ */
+typedef bool gene_filter_fn(gene_id id, void *arg);
+
+/**
+ * @brief removes every gene whose ID keep rejects and shrinks the counter to fit the rest
+ * 
+ * IDs are never reused, so a removed gene that shows up again is given a new ID.
+ * 
+ * @param I the counter to compact
+ * @param keep returns whether a gene stays in the counter
+ * @param arg the argument passed to every call of keep
  */
-//Precondition: I != NULL and inovation_counter_get(I, k) != NULL
-//Postcondition: inovation_counter_get(I, k) == NULL
-entry inovation_counter_remove(inovation_counter_t I, key k);
+//Precondition: I != NULL and keep != NULL
+//Postcondition: Result is the number of genes removed
+size_t inovation_counter_retain(inovation_counter_t I, gene_filter_fn *keep, void *arg);
 
 /**
- * @brief frees an inovation counter and all keys in it. 
+ * @brief removes every gene from the counter while keeping its memory for reuse
  * 
- * If key_free was NULL this does not free the keys.
+ * IDs are never reused, so genes added afterwards get IDs distinct from every ID given out before. A
+ * deferred counter instead starts its provisional IDs over from inovation_counter_get_next of the counter
+ * it reads through to.
  * 
+ * @param I the counter to clear
+ */
+//Precondition: I != NULL
+//Postcondition: inovation_counter_get_size(I) == 0
+void inovation_counter_clear(inovation_counter_t I);
+
+/**
+ * @brief returns the number of genes in the counter
+ * @param I the counter to query
+ */
+//Precondition: I != NULL
+size_t inovation_counter_get_size(inovation_counter_t I);
+
+/**
+ * @brief returns the number of bytes of memory held by the counter
+ * @param I the counter to query
+ */
+//Precondition: I != NULL
+size_t inovation_counter_get_bytes(inovation_counter_t I);
+
+/**
+ * @brief frees an inovation counter
  * @param I the inovation counter to free
  */
 //Precondition: I != NULL
 //Postcondition: I is freed
 void inovation_counter_free(inovation_counter_t I);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include "network.h"
+#include "matrix.h"
+#include "activation.h"
+
+// number of connections of a sparse level activated together
+#define LAYERED_CHUNK 64
+
+struct level_header{
+  size_t first; // first node of the level
+  size_t last; // one past the last node of the level
+  size_t source; // first node of the span feeding a dense block
+  matrix_t dense; // NULL when the level is evaluated connection by connection
+  size_t edge_first; // the connections into a sparse level
+  size_t edge_last;
+};
+typedef struct level_header level;
+
+struct layered_network_header{
+  size_t input;
+  size_t output;
+  size_t size;
+  size_t num_levels;
+  size_t num_dense;
+  level *levels;
+  size_t num_edges;
+  double *weight;
+  vertex *start;
+  vertex *end;
+  activation_fn *F;
+  activation_kind kind;
+};
+typedef struct layered_network_header layered_network;
+
+//helper functions
+
+// adds the sum of F(w * x) over each row of the block to y, missing connections being zero weights
+void dense_activate(layered_network *L, matrix_t M, double *x, double *y){
+  if(L->kind == ACTIVATION_IDENTITY){
+    matrix_mult_vec_add(M, x, y);
+    return;
+  }
+  size_t rows = matrix_get_rows(M);
+  size_t cols = matrix_get_cols(M);
+  double *w = matrix_get_data(M);
+  for(size_t i = 0; i < rows; i++){
+    y[i] += activation_dot(L->kind, L->F, w + i * cols, x, cols);
+  }
+}
+
+// the connections into one level never feed each other, so they can be gathered, activated together and
+// scattered back
+void sparse_activate(layered_network *L, size_t first, size_t last, double *values){
+  double chunk[LAYERED_CHUNK];
+  for(size_t i = first; i < last; i += LAYERED_CHUNK){
+    size_t n = last - i < LAYERED_CHUNK ? last - i : LAYERED_CHUNK;
+    for(size_t k = 0; k < n; k++){
+      chunk[k] = L->weight[i + k] * values[L->start[i + k]];
+    }
+    activation_apply(L->kind, L->F, chunk, n);
+    for(size_t k = 0; k < n; k++){
+      values[L->end[i + k]] += chunk[k];
+    }
+  }
+}
+
+// values must have room for L->size nodes
+void layered_eval(layered_network *L, double *input, double *output, double *values){
+  for(size_t i = 0; i < L->input; i++){
+    values[i] = input[i];
+  }
+  for(size_t i = L->input; i < L->size; i++){
+    values[i] = 0.0;
+  }
+  for(size_t l = 0; l < L->num_levels; l++){
+    level *lvl = &L->levels[l];
+    if(lvl->dense != NULL) dense_activate(L, lvl->dense, values + lvl->source, values + lvl->first);
+    else sparse_activate(L, lvl->edge_first, lvl->edge_last, values);
+  }
+  for(size_t i = 0; i < L->output; i++){
+    output[i] = values[L->size - L->output + i];
+  }
+  activation_apply(L->kind, L->F, output, L->output);
+}
+//end helper functions
+
+layered_network *layered_new(network_t N, double min_density){
+  size_t size = network_get_size(N);
+  size_t output = network_get_output(N);
+  size_t num_edges = network_get_num_edges(N);
+  vertex *start = malloc(num_edges * sizeof(vertex));
+  vertex *end = malloc(num_edges * sizeof(vertex));
+  double *weight = malloc(num_edges * sizeof(double));
+  for(size_t i = 0; i < num_edges; i++){
+    network_get_edge(N, i, &start[i], &end[i], &weight[i]);
+  }
+
+  // connections are sorted by start, so a node's depth is final before any of its connections are read
+  size_t *depth = calloc(size, sizeof(size_t));
+  size_t max_depth = 0;
+  for(size_t i = 0; i < num_edges; i++){
+    if(depth[start[i]] + 1 > depth[end[i]]) depth[end[i]] = depth[start[i]] + 1;
+  }
+  for(size_t v = 0; v < size - output; v++){
+    if(depth[v] > max_depth) max_depth = depth[v];
+  }
+  // outputs all go in one final level so they stay the last nodes
+  for(size_t v = size - output; v < size; v++){
+    depth[v] = max_depth + 1;
+  }
+  size_t num_depths = max_depth + 2;
+
+  // renumber the nodes by (depth, old number); inputs keep the lowest numbers and outputs the highest
+  size_t *level_first = calloc(num_depths + 1, sizeof(size_t));
+  for(size_t v = 0; v < size; v++){
+    level_first[depth[v] + 1]++;
+  }
+  for(size_t d = 0; d < num_depths; d++){
+    level_first[d + 1] += level_first[d];
+  }
+  vertex *renumber = malloc(size * sizeof(vertex));
+  size_t *next = malloc(num_depths * sizeof(size_t));
+  for(size_t d = 0; d < num_depths; d++){
+    next[d] = level_first[d];
+  }
+  for(size_t v = 0; v < size; v++){
+    renumber[v] = next[depth[v]]++;
+  }
+
+  // group the connections by the level of their end, keeping them ordered by start within a level
+  size_t *edge_first = calloc(num_depths + 1, sizeof(size_t));
+  for(size_t i = 0; i < num_edges; i++){
+    edge_first[depth[end[i]] + 1]++;
+  }
+  for(size_t d = 0; d < num_depths; d++){
+    edge_first[d + 1] += edge_first[d];
+    next[d] = edge_first[d];
+  }
+  size_t *order = malloc(num_edges * sizeof(size_t));
+  for(size_t i = 0; i < num_edges; i++){
+    order[next[depth[end[i]]]++] = i;
+  }
+
+  layered_network *L = malloc(sizeof(layered_network) + num_depths * sizeof(level)
+                              + num_edges * (sizeof(double) + 2 * sizeof(vertex)));
+  L->input = network_get_input(N);
+  L->output = output;
+  L->size = size;
+  L->F = network_get_activation(N);
+  L->kind = network_get_activation_kind(N);
+  L->levels = (level *)(L + 1);
+  L->weight = (double *)(L->levels + num_depths);
+  L->start = (vertex *)(L->weight + num_edges);
+  L->end = L->start + num_edges;
+  L->num_levels = 0;
+  L->num_dense = 0;
+  L->num_edges = 0;
+  bool zero_preserving = (*L->F)(0.0) == 0.0;
+
+  for(size_t d = 1; d < num_depths; d++){
+    if(edge_first[d] == edge_first[d + 1]) continue;
+    level *lvl = &L->levels[L->num_levels];
+    L->num_levels++;
+    lvl->first = level_first[d];
+    lvl->last = level_first[d + 1];
+    lvl->dense = NULL;
+
+    size_t source = size;
+    size_t source_end = 0;
+    for(size_t k = edge_first[d]; k < edge_first[d + 1]; k++){
+      vertex s = renumber[start[order[k]]];
+      if(s < source) source = s;
+      if(s + 1 > source_end) source_end = s + 1;
+    }
+    size_t count = edge_first[d + 1] - edge_first[d];
+    double density = (double)count / ((double)(lvl->last - lvl->first) * (double)(source_end - source));
+
+    if(zero_preserving && density >= min_density){
+      lvl->source = source;
+      lvl->dense = matrix_new(lvl->last - lvl->first, source_end - source);
+      for(size_t k = edge_first[d]; k < edge_first[d + 1]; k++){
+        size_t i = order[k];
+        matrix_set(lvl->dense, renumber[end[i]] - lvl->first, renumber[start[i]] - source, weight[i]);
+      }
+      L->num_dense++;
+    } else{
+      lvl->edge_first = L->num_edges;
+      for(size_t k = edge_first[d]; k < edge_first[d + 1]; k++){
+        size_t i = order[k];
+        L->weight[L->num_edges] = weight[i];
+        L->start[L->num_edges] = renumber[start[i]];
+        L->end[L->num_edges] = renumber[end[i]];
+        L->num_edges++;
+      }
+      lvl->edge_last = L->num_edges;
+    }
+  }
+
+  free(order);
+  free(edge_first);
+  free(next);
+  free(renumber);
+  free(level_first);
+  free(depth);
+  free(start);
+  free(end);
+  free(weight);
+  return L;
+}
+
+double *layered_calc(layered_network *L, double *input){
+  double *values = malloc(L->size * sizeof(double));
+  double *output = malloc(L->output * sizeof(double));
+  layered_eval(L, input, output, values);
+  free(values);
+  return output;
+}
+
+void layered_calc_into(layered_network *L, double *input, double *output, network_workspace_t W){
+  layered_eval(L, input, output, network_workspace_get_data(W));
+}
+
+size_t layered_get_num_levels(layered_network *L){
+  return L->num_levels;
+}
+
+size_t layered_get_num_dense(layered_network *L){
+  return L->num_dense;
+}
+
+void layered_free(layered_network *L){
+  for(size_t l = 0; l < L->num_levels; l++){
+    if(L->levels[l].dense != NULL) matrix_free(L->levels[l].dense);
+  }
+  free(L);
+}
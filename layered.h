@@ -0,0 +1,74 @@
+/**
+ * A layered network is a network recompiled for fast inference. Its nodes are renumbered so that every
+ * level of the topological ordering (the nodes whose longest path from an input has the same length) is
+ * contiguous. Each level is then evaluated either connection by connection or, when the connections
+ * into it are dense enough, as one dense block with a matrix kernel, which lets large evolved networks
+ * run close to the speed of an equivalent multilayer perceptron.
+ */
+#ifndef LAYERED_H
+#define LAYERED_H
+
+#include "network.h"
+
+typedef struct layered_network_header *layered_network_t;
+
+/**
+ * @brief compiles a network into levels
+ * 
+ * A level is stored as a dense block when the fraction of possible connections between its nodes and
+ * the span of nodes feeding it that actually exist is at least min_density. Dense blocks are only used
+ * when the activation function maps 0 to 0, since missing connections are stored as zero weights.
+ * 
+ * The layered network copies everything it needs, so N can be freed afterwards.
+ * 
+ * @param N the network to compile
+ * @param min_density the density at which a level switches to a dense block, in [0, 1]
+ */
+//Precondition: N != NULL
+//Postcondition: Result is not NULL
+layered_network_t layered_new(network_t N, double min_density);
+
+/**
+ * @brief computes the result of running the layered network on the given input
+ * @param L the network to run
+ * @param input the values for the input nodes
+ */
+//Must free result
+//Precondition: L != NULL
+//Postcondition: Result is not NULL
+double *layered_calc(layered_network_t L, double *input);
+
+/**
+ * @brief computes the result of running the layered network on the given input without allocating memory
+ * @param L the network to run
+ * @param input the values for the input nodes
+ * @param output where to write the values of the output nodes
+ * @param W the scratch space to evaluate in
+ */
+//Precondition: L != NULL, output has room for every output, and W != NULL was created for a network with at
+//              least as many nodes as the one L was compiled from
+void layered_calc_into(layered_network_t L, double *input, double *output, network_workspace_t W);
+
+/**
+ * @brief returns the number of levels with incoming connections
+ * @param L the network to query
+ */
+//Precondition: L != NULL
+size_t layered_get_num_levels(layered_network_t L);
+
+/**
+ * @brief returns the number of levels evaluated as dense blocks
+ * @param L the network to query
+ */
+//Precondition: L != NULL
+size_t layered_get_num_dense(layered_network_t L);
+
+/**
+ * @brief frees a layered network
+ * @param L the network to free
+ */
+//Precondition: L != NULL
+//Postcondition: L is freed
+void layered_free(layered_network_t L);
+
+#endif // LAYERED_H
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+#include "network.h"
+#include "matrix.h"
+#include "activation.h"
+
+// Connections are stored in rounds: round r holds connection r of every network that has more than r
+// connections. Connections in one round belong to different networks and can't depend on each other,
+// so a round is gathered into one array, activated and scattered back, each loop running across
+// individuals with no dependence between iterations.
+struct lockstep_header{
+  size_t count;
+  size_t input;
+  size_t output;
+  size_t num_nodes;
+  size_t num_edges;
+  size_t num_rounds;
+  size_t *first; // index of the first node of each network, count + 1 entries
+  size_t *round_first; // index of the first connection of each round, num_rounds + 1 entries
+  double *values;
+  double *scratch; // the activations of one round
+  double *weight;
+  size_t *start; // node indices into values
+  size_t *end;
+  activation_fn *F;
+  activation_kind kind;
+};
+typedef struct lockstep_header lockstep;
+
+struct edge_count_header{
+  size_t edges;
+  size_t index;
+};
+typedef struct edge_count_header edge_count;
+
+//helper functions
+
+int edge_count_compare(const void *a, const void *b){
+  size_t e1 = ((edge_count *)a)->edges;
+  size_t e2 = ((edge_count *)b)->edges;
+  if(e1 == e2) return 0;
+  return e1 > e2 ? -1 : 1;
+}
+//end helper functions
+
+lockstep *lockstep_new(network_t *networks, size_t count){
+  // with the networks ordered by decreasing connection count, every round is a prefix of that order
+  edge_count *order = malloc(count * sizeof(edge_count));
+  size_t num_nodes = 0;
+  size_t num_edges = 0;
+  for(size_t i = 0; i < count; i++){
+    order[i].edges = network_get_num_edges(networks[i]);
+    order[i].index = i;
+    num_nodes += network_get_size(networks[i]);
+    num_edges += order[i].edges;
+  }
+  qsort(order, count, sizeof(edge_count), &edge_count_compare);
+  size_t num_rounds = order[0].edges;
+
+  lockstep *L = malloc(sizeof(lockstep) + (num_nodes + count + num_edges) * sizeof(double)
+                       + (count + 1 + num_rounds + 1 + 2 * num_edges) * sizeof(size_t));
+  L->count = count;
+  L->input = network_get_input(networks[0]);
+  L->output = network_get_output(networks[0]);
+  L->num_nodes = num_nodes;
+  L->num_edges = num_edges;
+  L->num_rounds = num_rounds;
+  L->F = network_get_activation(networks[0]);
+  L->kind = network_get_activation_kind(networks[0]);
+  L->values = (double *)(L + 1);
+  L->scratch = L->values + num_nodes;
+  L->weight = L->scratch + count;
+  L->first = (size_t *)(L->weight + num_edges);
+  L->round_first = L->first + count + 1;
+  L->start = L->round_first + num_rounds + 1;
+  L->end = L->start + num_edges;
+
+  size_t node = 0;
+  for(size_t i = 0; i < count; i++){
+    L->first[i] = node;
+    node += network_get_size(networks[i]);
+  }
+  L->first[count] = node;
+
+  size_t in_round = count;
+  L->round_first[0] = 0;
+  for(size_t r = 0; r < num_rounds; r++){
+    while(order[in_round - 1].edges <= r) in_round--;
+    L->round_first[r + 1] = L->round_first[r] + in_round;
+  }
+
+  for(size_t k = 0; k < count; k++){
+    network_t N = networks[order[k].index];
+    size_t offset = L->first[order[k].index];
+    for(size_t r = 0; r < order[k].edges; r++){
+      size_t edge = L->round_first[r] + k;
+      vertex start;
+      vertex end;
+      network_get_edge(N, r, &start, &end, &L->weight[edge]);
+      L->start[edge] = offset + start;
+      L->end[edge] = offset + end;
+    }
+  }
+  free(order);
+  return L;
+}
+
+size_t lockstep_get_count(lockstep *L){
+  return L->count;
+}
+
+void lockstep_step(lockstep *L, matrix_t input, matrix_t output){
+  double *in = matrix_get_data(input);
+  double *out = matrix_get_data(output);
+  memset(L->values, 0, L->num_nodes * sizeof(double));
+  for(size_t i = 0; i < L->count; i++){
+    memcpy(L->values + L->first[i], in + i * L->input, L->input * sizeof(double));
+  }
+
+  for(size_t r = 0; r < L->num_rounds; r++){
+    size_t first = L->round_first[r];
+    size_t n = L->round_first[r + 1] - first;
+    for(size_t i = 0; i < n; i++){
+      L->scratch[i] = L->weight[first + i] * L->values[L->start[first + i]];
+    }
+    activation_apply(L->kind, L->F, L->scratch, n);
+    for(size_t i = 0; i < n; i++){
+      L->values[L->end[first + i]] += L->scratch[i];
+    }
+  }
+
+  for(size_t i = 0; i < L->count; i++){
+    memcpy(out + i * L->output, L->values + L->first[i + 1] - L->output, L->output * sizeof(double));
+  }
+  activation_apply(L->kind, L->F, out, L->count * L->output);
+}
+
+void lockstep_free(lockstep *L){
+  free(L);
+}
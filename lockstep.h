@@ -0,0 +1,57 @@
+/**
+ * A lockstep engine advances a whole population of networks by one step per call, which is how control
+ * tasks evaluate a generation: every individual sees its own observation and acts at the same time.
+ * 
+ * The networks are packed into shared structure-of-arrays buffers, so a step is one pass over the
+ * connections of the entire population instead of one call, buffer and edge list per network. The
+ * connections are interleaved across networks so that activations are computed for many individuals
+ * at once. Inputs and outputs are matrices with one row per network, so an environment holding its
+ * state the same way can be stepped in bulk too.
+ */
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "network.h"
+#include "matrix.h"
+
+typedef struct lockstep_header *lockstep_t;
+
+/**
+ * @brief packs a population of networks into a lockstep engine
+ * 
+ * The engine copies everything it needs, so the networks can be freed afterwards.
+ * 
+ * @param networks the networks to pack, such as the result of neat_get_gen
+ * @param count the number of networks
+ */
+//Precondition: count > 0, networks != NULL, and all networks have the same number of inputs, the same
+//              number of outputs, and the same activation function
+//Postcondition: Result is not NULL
+lockstep_t lockstep_new(network_t *networks, size_t count);
+
+/**
+ * @brief returns the number of networks in an engine
+ * @param L the engine to query
+ */
+//Precondition: L != NULL
+size_t lockstep_get_count(lockstep_t L);
+
+/**
+ * @brief runs every network in the engine once on its own input
+ * @param L the engine to step
+ * @param input the input of network i in row i
+ * @param output where to write the output of network i, in row i
+ */
+//Precondition: L != NULL, input is lockstep_get_count(L) by the number of network inputs, and output is
+//              lockstep_get_count(L) by the number of network outputs
+void lockstep_step(lockstep_t L, matrix_t input, matrix_t output);
+
+/**
+ * @brief frees a lockstep engine
+ * @param L the engine to free
+ */
+//Precondition: L != NULL
+//Postcondition: L is freed
+void lockstep_free(lockstep_t L);
+
+#endif // LOCKSTEP_H
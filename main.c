@@ -4,42 +4,69 @@
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <math.h>
+#include <pthread.h>
 
-double sig(double x){
-  return 2.0/(1.0+exp(-4.9*x)) - 1.0;
+// fitness functions may run on several threads at once, so every thread keeps its own workspace, grown
+// to the largest network it has evaluated, and evaluating a network never allocates
+struct workspace_header{
+  network_workspace_t W;
+  size_t size;
+};
+typedef struct workspace_header workspace;
+
+static pthread_key_t workspace_key;
+static pthread_once_t workspace_once = PTHREAD_ONCE_INIT;
+
+void workspace_free(void *arg){
+  workspace *S = (workspace *)arg;
+  network_workspace_free(S->W);
+  free(S);
+}
+
+void workspace_key_init(void){
+  pthread_key_create(&workspace_key, &workspace_free);
+}
+
+network_workspace_t thread_workspace(network_t N){
+  pthread_once(&workspace_once, &workspace_key_init);
+  workspace *S = pthread_getspecific(workspace_key);
+  if(S == NULL){
+    S = malloc(sizeof(workspace));
+    S->W = network_workspace_new(N);
+    S->size = network_get_size(N);
+    pthread_setspecific(workspace_key, S);
+  } else if(S->size < network_get_size(N)){
+    network_workspace_free(S->W);
+    S->W = network_workspace_new(N);
+    S->size = network_get_size(N);
+  }
+  return S->W;
 }
 
 double xor_test(network_t N){
   double score = 4.0;
-  double *in = malloc(sizeof(double)*3);
-  in[0] = 0.0;
-  in[1] = 0.0;
-  in[2] = 1.0;
-  double *out = network_calc(N, in);
-  score -= *out * *out;
-  free(out);
+  network_workspace_t W = thread_workspace(N);
+  double in[3] = {0.0, 0.0, 1.0};
+  double out;
+  network_calc_into(N, in, &out, W);
+  score -= out * out;
   in[0] = 1.0;
-  out = network_calc(N, in);
-  if(*out < 0) score -= 1.0;
-  else score -= (1.0 - *out) * (1.0 - *out);
-  free(out);
+  network_calc_into(N, in, &out, W);
+  if(out < 0) score -= 1.0;
+  else score -= (1.0 - out) * (1.0 - out);
   in[1] = 1.0;
-  out = network_calc(N, in);
-  score -= *out * *out;
-  free(out);
+  network_calc_into(N, in, &out, W);
+  score -= out * out;
   in[0] = 0.0;
-  out = network_calc(N, in);
-  if(*out < 0) score -= 1.0;
-  else score -= (1.0 - *out) * (1.0 - *out);
-  free(out);
-  free(in);
+  network_calc_into(N, in, &out, W);
+  if(out < 0) score -= 1.0;
+  else score -= (1.0 - out) * (1.0 - out);
   return score;
 }
 
 int main(void) {
   srand(time(NULL));
-  neat_t N = neat_new(150, 3, 1, 3.0 , 1.0, 1.0, 0.4, &xor_test, &sig);
+  neat_t N = neat_new(150, 3, 1, 3.0 , 1.0, 1.0, 0.4, &xor_test, &activation_signed_sigmoid);
   bool b = true;
   double fitt = 0.0;
   for(int i = 0; i < 300 && b && fitt < 3.999; i++) {
@@ -75,5 +102,9 @@ int main(void) {
   free(in);
   free(fit);
   neat_free(N);
+  // destructors of thread-specific data don't run for the main thread
+  pthread_once(&workspace_once, &workspace_key_init);
+  workspace *S = pthread_getspecific(workspace_key);
+  if(S != NULL) workspace_free(S);
   return 0;
 }
\ No newline at end of file
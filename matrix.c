@@ -32,6 +32,10 @@ void matrix_set(matrix *M, size_t row, size_t col, double val){
   M->data[row*M->cols + col] = val;
 }
 
+double *matrix_get_data(matrix *M){
+  return M->data;
+}
+
 matrix *matrix_mult(matrix *A, matrix *B){
   matrix *M = malloc(sizeof(matrix));
   M->rows = A->rows;
@@ -49,6 +53,17 @@ matrix *matrix_mult(matrix *A, matrix *B){
   return M;
 }
 
+void matrix_mult_vec_add(matrix *A, double *x, double *y){
+  for(size_t i = 0; i < A->rows; i++){
+    double *row = A->data + i*A->cols;
+    double sum = 0;
+    for(size_t k = 0; k < A->cols; k++){
+      sum += row[k]*x[k];
+    }
+    y[i] += sum;
+  }
+}
+
 void matrix_print(matrix *M){
   for(size_t i = 0; i < M->rows; i++){
     for(size_t j = 0; j < M->cols; j++){
@@ -47,6 +47,18 @@ double matrix_get(matrix_t M, size_t row, size_t col);
 //Precondition: M != NULL, rows < matrix_get_rows(M), and cols < matrix_get_cols(M)
 void matrix_set(matrix_t M, size_t row, size_t col, double val);
 
+/**
+ * @brief returns the entries of a matrix stored row by row
+ * 
+ * The entry at (row, col) is at index row * matrix_get_cols(M) + col. Writes through the result change M.
+ * 
+ * @param M the matrix to query
+ */
+//Don't free result
+//Precondition: M != NULL
+//Postcondition: Result is not NULL
+double *matrix_get_data(matrix_t M);
+
 /**
  * @brief creates a new matrix consisting of AB using matrix multiplication
  * @param A the matrix on the left
@@ -57,6 +69,15 @@ void matrix_set(matrix_t M, size_t row, size_t col, double val);
 //Postcondition: Result != NULL
 matrix_t matrix_mult(matrix_t A, matrix_t B);
 
+/**
+ * @brief adds the product Ax to y without allocating
+ * @param A the matrix to multiply by
+ * @param x a vector of matrix_get_cols(A) values
+ * @param y a vector of matrix_get_rows(A) values to add the product to
+ */
+//Precondition: A != NULL, x != NULL, y != NULL, and x and y don't overlap
+void matrix_mult_vec_add(matrix_t A, double *x, double *y);
+
 /**
  * @brief prints out the contents of a matrix
  * @param M the matrix to print
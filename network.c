@@ -1,82 +1,314 @@
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "matrix.h"
+#include "activation.h"
 
 typedef unsigned int vertex;
-typedef double activation_fn(double);
-
-typedef struct node_header node;
-struct node_header{
-  double weight;
-  vertex v;
-  node *next;
-};
 
+// connections are stored as parallel arrays sorted by start vertex and live in the same allocation as
+// the header, so evaluating a network is one linear pass over contiguous memory
 struct network_header{
   size_t input;
   size_t output;
   size_t size;
-  node **data;
+  size_t num_edges;
+  size_t compacity;
+  double *weight;
+  vertex *start;
+  vertex *end;
   activation_fn *F;
+  activation_kind kind;
+  void *map; // the mapped file the arrays point into for loaded networks, NULL otherwise
+  size_t map_bytes;
 };
 typedef struct network_header network;
 
-double default_activation_fn(double x){
-  return x;
-}
+struct network_workspace_header{
+  size_t size;
+  double values[];
+};
+typedef struct network_workspace_header network_workspace;
 
-network *network_new(size_t input, size_t output, size_t size, activation_fn *F){
-  network *N = malloc(sizeof(network));
+// number of samples pushed through each connection at once by network_calc_batch
+#define NETWORK_BATCH_TILE 64
+
+// on disk a network is this header followed by the weight, start and end arrays, each starting on a
+// multiple of NETWORK_FILE_ALIGN bytes so a mapped file can be evaluated in place
+struct network_file_header{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order; // NETWORK_FILE_BYTE_ORDER as written by the saving machine
+  uint64_t input;
+  uint64_t output;
+  uint64_t size;
+  uint64_t num_edges;
+  uint32_t kind;
+  uint32_t reserved;
+};
+typedef struct network_file_header network_file;
+
+#define NETWORK_FILE_MAGIC "NEATNET"
+#define NETWORK_FILE_VERSION 1
+#define NETWORK_FILE_BYTE_ORDER 0x01020304u
+#define NETWORK_FILE_ALIGN 64
+
+network *network_new(size_t input, size_t output, size_t size, size_t edges, activation_fn *F){
+  network *N = malloc(sizeof(network) + edges * (sizeof(double) + 2 * sizeof(vertex)));
   N->input = input;
   N->output = output;
   N->size = size;
-  N->F = F == NULL ? &default_activation_fn : F;
-  N->data = calloc(size, sizeof(node*));
+  N->num_edges = 0;
+  N->compacity = edges;
+  N->F = F == NULL ? &activation_identity : F;
+  N->kind = activation_get_kind(F);
+  N->weight = (double *)(N + 1);
+  N->start = (vertex *)(N->weight + edges);
+  N->end = N->start + edges;
+  N->map = NULL;
+  N->map_bytes = 0;
   return N;
 }
 
 // can't add same connection twice
 void network_add_connection(network *N, vertex start, vertex end, double weight){
-  node *n = malloc(sizeof(node));
-  n->weight = weight;
-  n->v = end;
-  n->next = N->data[start];
-  N->data[start] = n;
+  N->weight[N->num_edges] = weight;
+  N->start[N->num_edges] = start;
+  N->end[N->num_edges] = end;
+  N->num_edges++;
 }
 
-double *network_calc(network *N, double *input){
-  double *weights = calloc(N->size, sizeof(double));
-  double *output = malloc(N->output*sizeof(double));
+//helper functions
+
+// values must have room for N->size nodes
+void network_eval(network *N, double *input, double *output, double *values){
   for(size_t i = 0; i < N->input; i++){
-    weights[i] = input[i];
+    values[i] = input[i];
   }
-  for(size_t i = 0; i < N->size - N->output; i++){
-    node *n = N->data[i];
-    while(n != NULL){
-      weights[n->v] += (*(N->F))(n->weight * weights[i]);
-      n = n->next;
-    }
+  for(size_t i = N->input; i < N->size; i++){
+    values[i] = 0.0;
   }
+#define NETWORK_EDGE_LOOP(ACT)                                     \
+  for(size_t i = 0; i < N->num_edges; i++){                        \
+    values[N->end[i]] += ACT(N->weight[i] * values[N->start[i]]); \
+  }
+  ACTIVATION_SPECIALIZE(N->kind, N->F, NETWORK_EDGE_LOOP)
+#undef NETWORK_EDGE_LOOP
   for(size_t i = 0; i < N->output; i++){
-    output[i] = (*(N->F))(weights[N->size - N->output + i]);
+    output[i] = values[N->size - N->output + i];
   }
-  free(weights);
+  activation_apply(N->kind, N->F, output, N->output);
+}
+
+
+size_t network_file_align(size_t bytes){
+  return (bytes + NETWORK_FILE_ALIGN - 1) / NETWORK_FILE_ALIGN * NETWORK_FILE_ALIGN;
+}
+
+// offsets of the weight, start and end arrays in a file and its total length
+void network_file_layout(size_t num_edges, size_t *weight, size_t *start, size_t *end, size_t *bytes){
+  *weight = network_file_align(sizeof(network_file));
+  *start = network_file_align(*weight + num_edges * sizeof(double));
+  *end = network_file_align(*start + num_edges * sizeof(uint32_t));
+  *bytes = *end + num_edges * sizeof(uint32_t);
+}
+
+// writes zeros until the file is offset bytes long
+int network_file_pad(FILE *out, size_t *written, size_t offset){
+  static const char zeros[NETWORK_FILE_ALIGN] = {0};
+  size_t n = offset - *written;
+  *written = offset;
+  return fwrite(zeros, 1, n, out) == n ? 0 : -1;
+}
+//end helper functions
+
+double *network_calc(network *N, double *input){
+  double *values = malloc(N->size*sizeof(double));
+  double *output = malloc(N->output*sizeof(double));
+  network_eval(N, input, output, values);
+  free(values);
   return output;
 }
 
+void network_calc_batch(network *N, matrix_t input, matrix_t output){
+  size_t rows = matrix_get_rows(input);
+  double *in = matrix_get_data(input);
+  double *out = matrix_get_data(output);
+  // values[v * NETWORK_BATCH_TILE + s] is node v for sample s of the current tile
+  double *values = malloc(N->size * NETWORK_BATCH_TILE * sizeof(double));
+  for(size_t first = 0; first < rows; first += NETWORK_BATCH_TILE){
+    size_t n = rows - first < NETWORK_BATCH_TILE ? rows - first : NETWORK_BATCH_TILE;
+    for(size_t i = 0; i < N->input; i++){
+      for(size_t s = 0; s < n; s++){
+        values[i * NETWORK_BATCH_TILE + s] = in[(first + s) * N->input + i];
+      }
+    }
+    for(size_t i = N->input; i < N->size; i++){
+      for(size_t s = 0; s < n; s++){
+        values[i * NETWORK_BATCH_TILE + s] = 0.0;
+      }
+    }
+
+    for(size_t i = 0; i < N->num_edges; i++){
+      double *x = values + N->start[i] * NETWORK_BATCH_TILE;
+      double *y = values + N->end[i] * NETWORK_BATCH_TILE;
+      activation_axpy(N->kind, N->F, N->weight[i], x, y, n);
+    }
+
+    for(size_t i = 0; i < N->output; i++){
+      double *y = values + (N->size - N->output + i) * NETWORK_BATCH_TILE;
+      activation_apply(N->kind, N->F, y, n);
+      for(size_t s = 0; s < n; s++){
+        out[(first + s) * N->output + i] = y[s];
+      }
+    }
+  }
+  free(values);
+}
+
+network_workspace *network_workspace_new(network *N){
+  network_workspace *W = malloc(sizeof(network_workspace) + N->size * sizeof(double));
+  W->size = N->size;
+  return W;
+}
+
+void network_calc_into(network *N, double *input, double *output, network_workspace *W){
+  network_eval(N, input, output, W->values);
+}
+
+double *network_workspace_get_data(network_workspace *W){
+  return W->values;
+}
+
+void network_workspace_free(network_workspace *W){
+  free(W);
+}
+
+size_t network_get_input(network *N){
+  return N->input;
+}
+
+size_t network_get_output(network *N){
+  return N->output;
+}
+
+size_t network_get_size(network *N){
+  return N->size;
+}
+
+size_t network_get_num_edges(network *N){
+  return N->num_edges;
+}
+
+void network_get_edge(network *N, size_t i, vertex *start, vertex *end, double *weight){
+  *start = N->start[i];
+  *end = N->end[i];
+  *weight = N->weight[i];
+}
+
 activation_fn *network_get_activation(network *N){
   return N->F;
 }
 
-void network_free(network *N){
-  for(size_t i = 0; i < N->size; i++){
-    node *n = N->data[i];
-    while(n != NULL){
-      node *next = n->next;
-      free(n);
-      n = next;
+activation_kind network_get_activation_kind(network *N){
+  return N->kind;
+}
+
+int network_save(network *N, const char *path){
+  FILE *out = fopen(path, "wb");
+  if(out == NULL) return -1;
+  network_file H;
+  memset(&H, 0, sizeof(network_file));
+  memcpy(H.magic, NETWORK_FILE_MAGIC, sizeof(NETWORK_FILE_MAGIC));
+  H.version = NETWORK_FILE_VERSION;
+  H.byte_order = NETWORK_FILE_BYTE_ORDER;
+  H.input = N->input;
+  H.output = N->output;
+  H.size = N->size;
+  H.num_edges = N->num_edges;
+  H.kind = N->kind;
+
+  size_t weight, start, end, bytes;
+  network_file_layout(N->num_edges, &weight, &start, &end, &bytes);
+  size_t written = sizeof(network_file);
+  int result = fwrite(&H, sizeof(network_file), 1, out) == 1 ? 0 : -1;
+  if(result == 0) result = network_file_pad(out, &written, weight);
+  if(result == 0 && fwrite(N->weight, sizeof(double), N->num_edges, out) != N->num_edges) result = -1;
+  written += N->num_edges * sizeof(double);
+  if(result == 0) result = network_file_pad(out, &written, start);
+  if(result == 0 && fwrite(N->start, sizeof(uint32_t), N->num_edges, out) != N->num_edges) result = -1;
+  written += N->num_edges * sizeof(uint32_t);
+  if(result == 0) result = network_file_pad(out, &written, end);
+  if(result == 0 && fwrite(N->end, sizeof(uint32_t), N->num_edges, out) != N->num_edges) result = -1;
+  if(fclose(out) != 0) result = -1;
+  return result;
+}
+
+network *network_load(const char *path, activation_fn *F){
+  int fd = open(path, O_RDONLY);
+  if(fd < 0) return NULL;
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(network_file)){
+    close(fd);
+    return NULL;
+  }
+  size_t map_bytes = (size_t)st.st_size;
+  void *map = mmap(NULL, map_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+  if(map == MAP_FAILED) return NULL;
+
+  network_file *H = (network_file *)map;
+  size_t weight, start, end, bytes;
+  bool valid = memcmp(H->magic, NETWORK_FILE_MAGIC, sizeof(NETWORK_FILE_MAGIC)) == 0 &&
+               H->version == NETWORK_FILE_VERSION && H->byte_order == NETWORK_FILE_BYTE_ORDER &&
+               // compared without sums that could wrap, and capped so every vertex fits in 32 bits
+               H->input > 0 && H->output > 0 && H->input <= H->size && H->output <= H->size - H->input &&
+               H->size <= UINT32_MAX &&
+               H->kind <= ACTIVATION_RELU && (H->kind != ACTIVATION_CUSTOM || F != NULL) &&
+               H->num_edges <= map_bytes / (sizeof(double) + 2 * sizeof(uint32_t));
+  if(valid){
+    network_file_layout(H->num_edges, &weight, &start, &end, &bytes);
+    valid = bytes <= map_bytes;
+  }
+  if(valid){
+    // every vertex is read unchecked during evaluation
+    uint32_t *S = (uint32_t *)((char *)map + start);
+    uint32_t *E = (uint32_t *)((char *)map + end);
+    for(size_t i = 0; valid && i < H->num_edges; i++){
+      valid = S[i] < H->size && E[i] < H->size;
     }
   }
-  free(N->data);
+  if(!valid){
+    munmap(map, map_bytes);
+    return NULL;
+  }
+
+  network *N = malloc(sizeof(network));
+  N->input = H->input;
+  N->output = H->output;
+  N->size = H->size;
+  N->num_edges = H->num_edges;
+  N->compacity = H->num_edges;
+  N->kind = (activation_kind)H->kind;
+  N->F = N->kind == ACTIVATION_CUSTOM ? F : activation_get(N->kind);
+  N->weight = (double *)((char *)map + weight);
+  N->start = (vertex *)((char *)map + start);
+  N->end = (vertex *)((char *)map + end);
+  N->map = map;
+  N->map_bytes = map_bytes;
+  return N;
+}
+
+void network_free(network *N){
+  if(N->map != NULL) munmap(N->map, N->map_bytes);
   free(N);
 }
 
-typedef network *network_t;
\ No newline at end of file
+typedef network *network_t;
@@ -1,36 +1,46 @@
 /*
     These are network objects which consist of multiple nodes and connection with weights. 
     Network evaluation occurs in linear time with respect to the number of nodes.
+
+    Networks are compiled: the connections are kept in flat arrays ordered by their start node inside a
+    single allocation, so evaluation is a linear scan instead of a walk over linked lists.
 */
 #ifndef NETWORK_H
 #define NETWORK_H
 
 #include <stdlib.h>
+#include "matrix.h"
+#include "activation.h"
 
 typedef unsigned int vertex;
-typedef double activation_fn(double);
 
 typedef struct network_header *network_t;
+typedef struct network_workspace_header *network_workspace_t;
 
 /**
  * @brief creates a new network
  * @param input the number of input nodes
  * @param output the number of output nodes
  * @param size total number of nodes in the network
- * @param F function to apply to all node output
+ * @param edges the number of connections that will be added to the network
+ * @param F function to apply to all node output, evaluated with specialized loops if it is built-in
  */
 //Precondition: input > 0, output > 0, size >= input + output
 //Postcondition: Result is not NULL
-network_t network_new(size_t input, size_t output, size_t size, activation_fn *F);
+network_t network_new(size_t input, size_t output, size_t size, size_t edges, activation_fn *F);
 
 /**
  * @brief adds a connection between two nodes
+ * 
+ * Connections must be added in order of their start vertex, which is the order they are evaluated in.
+ * 
  * @param N the network to alter
  * @param start the start vertex in the connection
  * @param end the end vertex of the connection
  * @param weight the weight of the connection
  */
-//Precondition: N != NULL and start < end
+//Precondition: N != NULL, start < end, start is not an output node, fewer than edges connections
+//              have been added, and start is at least the start of the previously added connection
 void network_add_connection(network_t N, vertex start, vertex end, double weight);
 
 /**
@@ -42,6 +52,106 @@ void network_add_connection(network_t N, vertex start, vertex end, double weight
 //Postcondition: Result is not NULL
 double *network_calc(network_t N, double *input);
 
+/**
+ * @brief runs the network on every row of a matrix at once
+ * 
+ * Each row of input is one sample and the matching row of output receives its result. Samples are pushed
+ * through each connection together, so this is much faster than calling network_calc once per row.
+ * 
+ * @param N the network to run
+ * @param input the samples to evaluate, one per row
+ * @param output where to write the results, one row per sample
+ */
+//Precondition: N != NULL, input != NULL, output != NULL, matrix_get_cols(input) == network_get_input(N),
+//              matrix_get_rows(output) == matrix_get_rows(input), and
+//              matrix_get_cols(output) == network_get_output(N)
+void network_calc_batch(network_t N, matrix_t input, matrix_t output);
+
+/**
+ * @brief creates the scratch space needed to evaluate a network without allocating
+ * 
+ * A workspace can be reused for any network with at least as many nodes as N, but only by one evaluation
+ * at a time.
+ * 
+ * @param N the network to size the workspace for
+ */
+//Precondition: N != NULL
+//Postcondition: Result is not NULL
+network_workspace_t network_workspace_new(network_t N);
+
+/**
+ * @brief computes the result of running the network on the given input without allocating any memory
+ * @param N the network to run
+ * @param input the values for the input nodes
+ * @param output where to write the values of the output nodes
+ * @param W the scratch space to evaluate in
+ */
+//Precondition: N != NULL, output has room for network_get_output(N) values, and W != NULL was created
+//              for a network with at least network_get_size(N) nodes
+void network_calc_into(network_t N, double *input, double *output, network_workspace_t W);
+
+/**
+ * @brief returns the scratch buffer of a workspace, for evaluators built on top of networks
+ * 
+ * The buffer holds one double for every node of the network the workspace was created for.
+ * 
+ * @param W the workspace to query
+ */
+//Don't free result
+//Precondition: W != NULL
+//Postcondition: Result is not NULL
+double *network_workspace_get_data(network_workspace_t W);
+
+/**
+ * @brief frees a workspace
+ * @param W the workspace to free
+ */
+//Precondition: W != NULL
+//Postcondition: W is freed
+void network_workspace_free(network_workspace_t W);
+
+/**
+ * @brief returns the number of input nodes of a network
+ * @param N the network to query
+ */
+//Precondition: N != NULL
+size_t network_get_input(network_t N);
+
+/**
+ * @brief returns the number of output nodes of a network
+ * @param N the network to query
+ */
+//Precondition: N != NULL
+size_t network_get_output(network_t N);
+
+/**
+ * @brief returns the total number of nodes in a network
+ * @param N the network to query
+ */
+//Precondition: N != NULL
+size_t network_get_size(network_t N);
+
+/**
+ * @brief returns the number of connections in a network
+ * @param N the network to query
+ */
+//Precondition: N != NULL
+size_t network_get_num_edges(network_t N);
+
+/**
+ * @brief reads one connection of a network
+ * 
+ * Connections are numbered in evaluation order, so they come out sorted by start vertex.
+ * 
+ * @param N the network to query
+ * @param i the index of the connection
+ * @param start where to write the start vertex of the connection
+ * @param end where to write the end vertex of the connection
+ * @param weight where to write the weight of the connection
+ */
+//Precondition: N != NULL, i < network_get_num_edges(N), and start, end, weight != NULL
+void network_get_edge(network_t N, size_t i, vertex *start, vertex *end, double *weight);
+
 /**
  * @brief returns a pointer to the activation function of a network
  * @param N the network to query
@@ -50,6 +160,41 @@ double *network_calc(network_t N, double *input);
 //Postcondition: Result is not NULL
 activation_fn *network_get_activation(network_t N);
 
+/**
+ * @brief returns the built-in kind of the activation function of a network
+ * @param N the network to query
+ */
+//Precondition: N != NULL
+activation_kind network_get_activation_kind(network_t N);
+
+/**
+ * @brief writes a network to a file in the binary network format
+ * 
+ * The file holds a versioned header padded to 64 bytes followed by the weight, start and end arrays, each aligned
+ * to 64 bytes. Numbers are stored in the byte order of the saving machine. Custom activation functions
+ * can't be saved, so they have to be given again when loading.
+ * 
+ * @param N the network to save
+ * @param path the file to write, replacing it if it exists
+ */
+//Precondition: N != NULL and path != NULL
+//Postcondition: Result is 0 on success and -1 if the file couldn't be written
+int network_save(network_t N, const char *path);
+
+/**
+ * @brief loads a network saved by network_save
+ * 
+ * The file is memory-mapped and the network evaluates straight from the mapped arrays, so loading
+ * costs no parsing or copying. The file is unmapped by network_free, and must not change while the
+ * network is in use. No connections can be added to a loaded network.
+ * 
+ * @param path the file to load
+ * @param F the activation function to use if the network was saved with a custom one
+ */
+//Postcondition: Result is NULL if the file couldn't be read, isn't a valid network file of this
+//               version and byte order, or needs a custom activation and F is NULL
+network_t network_load(const char *path, activation_fn *F);
+
 /**
  * @brief frees a network
  * @param N the network to free
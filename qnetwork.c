@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "network.h"
+#include "matrix.h"
+#include "activation.h"
+
+enum qnetwork_precision_header{
+  PRECISION_FLOAT32,
+  PRECISION_INT8
+};
+typedef enum qnetwork_precision_header qnetwork_precision;
+
+// like a network, but the connections are stored at reduced precision and node values are floats
+struct qnetwork_header{
+  size_t input;
+  size_t output;
+  size_t size;
+  size_t num_edges;
+  size_t bytes;
+  qnetwork_precision precision;
+  float scale; // the value of one step of an int8 weight
+  // consecutive connections leaving the same node form a run, so the node's value is loaded and scaled
+  // once per run rather than once per connection
+  size_t num_runs;
+  size_t *first; // the connections of run r are [first[r], first[r + 1])
+  vertex *source; // the node all connections of run r leave
+  vertex *end;
+  float *weight; // PRECISION_FLOAT32 only
+  int8_t *qweight; // PRECISION_INT8 only
+  activation_fn *F;
+  activation_kind kind;
+};
+typedef struct qnetwork_header qnetwork;
+
+//helper functions
+
+// values must have room for Q->size floats
+void qnetwork_eval(qnetwork *Q, double *input, double *output, float *values){
+  for(size_t i = 0; i < Q->input; i++){
+    values[i] = (float)input[i];
+  }
+  for(size_t i = Q->input; i < Q->size; i++){
+    values[i] = 0.0f;
+  }
+  if(Q->precision == PRECISION_FLOAT32){
+#define QNETWORK_FLOAT_LOOP(ACT)                                        \
+    for(size_t r = 0; r < Q->num_runs; r++){                            \
+      float x = values[Q->source[r]];                                   \
+      for(size_t i = Q->first[r]; i < Q->first[r + 1]; i++){            \
+        values[Q->end[i]] += ACT(Q->weight[i] * x);                     \
+      }                                                                 \
+    }
+    ACTIVATION_SPECIALIZE_FLOAT(Q->kind, Q->F, QNETWORK_FLOAT_LOOP)
+#undef QNETWORK_FLOAT_LOOP
+  } else{
+    // w * x is scale * q * x, so scaling the node value once leaves a single multiply per connection
+#define QNETWORK_INT8_LOOP(ACT)                                         \
+    for(size_t r = 0; r < Q->num_runs; r++){                            \
+      float x = Q->scale * values[Q->source[r]];                        \
+      for(size_t i = Q->first[r]; i < Q->first[r + 1]; i++){            \
+        values[Q->end[i]] += ACT((float)Q->qweight[i] * x);             \
+      }                                                                 \
+    }
+    ACTIVATION_SPECIALIZE_FLOAT(Q->kind, Q->F, QNETWORK_INT8_LOOP)
+#undef QNETWORK_INT8_LOOP
+  }
+  for(size_t i = 0; i < Q->output; i++){
+    output[i] = (double)values[Q->size - Q->output + i];
+  }
+  activation_apply(Q->kind, Q->F, output, Q->output);
+}
+//end helper functions
+
+qnetwork *qnetwork_new(network_t N, qnetwork_precision P){
+  size_t num_edges = network_get_num_edges(N);
+  size_t num_runs = 0;
+  vertex last = 0;
+  for(size_t i = 0; i < num_edges; i++){
+    vertex start;
+    vertex end;
+    double w;
+    network_get_edge(N, i, &start, &end, &w);
+    if(i == 0 || start != last) num_runs++;
+    last = start;
+  }
+  size_t weight_bytes = P == PRECISION_FLOAT32 ? sizeof(float) : sizeof(int8_t);
+  size_t bytes = sizeof(qnetwork) + (num_runs + 1) * sizeof(size_t) + num_runs * sizeof(vertex) +
+                 num_edges * (sizeof(vertex) + weight_bytes);
+  qnetwork *Q = malloc(bytes);
+  Q->input = network_get_input(N);
+  Q->output = network_get_output(N);
+  Q->size = network_get_size(N);
+  Q->num_edges = num_edges;
+  Q->bytes = bytes;
+  Q->precision = P;
+  Q->F = network_get_activation(N);
+  Q->kind = network_get_activation_kind(N);
+  Q->num_runs = num_runs;
+  Q->first = (size_t *)(Q + 1);
+  Q->source = (vertex *)(Q->first + num_runs + 1);
+  Q->end = Q->source + num_runs;
+  Q->weight = NULL;
+  Q->qweight = NULL;
+
+  double max_weight = 0.0;
+  size_t r = 0;
+  for(size_t i = 0; i < num_edges; i++){
+    vertex start;
+    double w;
+    network_get_edge(N, i, &start, &Q->end[i], &w);
+    if(i == 0 || start != Q->source[r - 1]){
+      Q->first[r] = i;
+      Q->source[r] = start;
+      r++;
+    }
+    if(fabs(w) > max_weight) max_weight = fabs(w);
+  }
+  Q->first[num_runs] = num_edges;
+  Q->scale = max_weight > 0.0 ? (float)(max_weight / 127.0) : 1.0f;
+
+  if(P == PRECISION_FLOAT32) Q->weight = (float *)(Q->end + num_edges);
+  else Q->qweight = (int8_t *)(Q->end + num_edges);
+  for(size_t i = 0; i < num_edges; i++){
+    vertex start;
+    vertex end;
+    double w;
+    network_get_edge(N, i, &start, &end, &w);
+    if(P == PRECISION_FLOAT32) Q->weight[i] = (float)w;
+    else Q->qweight[i] = (int8_t)lrint(w / Q->scale);
+  }
+  return Q;
+}
+
+double *qnetwork_calc(qnetwork *Q, double *input){
+  float *values = malloc(Q->size * sizeof(float));
+  double *output = malloc(Q->output * sizeof(double));
+  qnetwork_eval(Q, input, output, values);
+  free(values);
+  return output;
+}
+
+void qnetwork_calc_into(qnetwork *Q, double *input, double *output, network_workspace_t W){
+  // a workspace holds a double per node, which leaves room for a float per node
+  qnetwork_eval(Q, input, output, (float *)network_workspace_get_data(W));
+}
+
+void qnetwork_error(qnetwork *Q, network_t N, matrix_t inputs, double *max_error, double *mean_error){
+  size_t rows = matrix_get_rows(inputs);
+  double *in = matrix_get_data(inputs);
+  double *expected = malloc(Q->output * sizeof(double));
+  double *actual = malloc(Q->output * sizeof(double));
+  network_workspace_t W = network_workspace_new(N);
+  double max = 0.0;
+  double total = 0.0;
+  for(size_t r = 0; r < rows; r++){
+    network_calc_into(N, in + r * Q->input, expected, W);
+    qnetwork_calc_into(Q, in + r * Q->input, actual, W);
+    for(size_t i = 0; i < Q->output; i++){
+      double error = fabs(expected[i] - actual[i]);
+      if(error > max) max = error;
+      total += error;
+    }
+  }
+  *max_error = max;
+  *mean_error = rows == 0 ? 0.0 : total / (double)(rows * Q->output);
+  network_workspace_free(W);
+  free(expected);
+  free(actual);
+}
+
+size_t qnetwork_get_bytes(qnetwork *Q){
+  return Q->bytes;
+}
+
+void qnetwork_free(qnetwork *Q){
+  free(Q);
+}
@@ -0,0 +1,83 @@
+/**
+ * Reduced precision copies of networks for serving evolved champions. Evolution always works on double
+ * precision networks; once a network is final it can be converted to float32 weights and node values,
+ * or to int8 weights with one scale for the whole network, cutting the memory each connection takes
+ * from 16 bytes to 8 or 5, plus 12 bytes for every node with outgoing connections. Both are evaluated
+ * entirely in single precision. qnetwork_error reports how far the converted network strays from the
+ * original on a set of inputs.
+ */
+#ifndef QNETWORK_H
+#define QNETWORK_H
+
+#include "network.h"
+#include "matrix.h"
+
+enum qnetwork_precision_header{
+  PRECISION_FLOAT32, // float weights
+  PRECISION_INT8 // weights rounded to multiples of max |weight| / 127
+};
+typedef enum qnetwork_precision_header qnetwork_precision;
+
+typedef struct qnetwork_header *qnetwork_t;
+
+/**
+ * @brief creates a reduced precision copy of a network
+ * 
+ * The copy doesn't refer to N, so N can be freed afterwards.
+ * 
+ * @param N the network to convert
+ * @param P the precision to store the network in
+ */
+//Precondition: N != NULL
+//Postcondition: Result is not NULL
+qnetwork_t qnetwork_new(network_t N, qnetwork_precision P);
+
+/**
+ * @brief computes the result of running the network on the given input
+ * @param Q the network to run
+ * @param input the values for the input nodes
+ */
+//Must free result
+//Precondition: Q != NULL
+//Postcondition: Result is not NULL
+double *qnetwork_calc(qnetwork_t Q, double *input);
+
+/**
+ * @brief computes the result of running the network on the given input without allocating memory
+ * @param Q the network to run
+ * @param input the values for the input nodes
+ * @param output where to write the values of the output nodes
+ * @param W the scratch space to evaluate in
+ */
+//Precondition: Q != NULL, output has room for every output, and W != NULL was created for a network with at
+//              least as many nodes as the one Q was converted from
+void qnetwork_calc_into(qnetwork_t Q, double *input, double *output, network_workspace_t W);
+
+/**
+ * @brief measures how far a converted network's outputs are from the original's
+ * @param Q the converted network
+ * @param N the network Q was converted from
+ * @param inputs the inputs to compare on, one per row
+ * @param max_error where to write the largest absolute difference of any output
+ * @param mean_error where to write the mean absolute difference over all outputs
+ */
+//Precondition: Q != NULL, N != NULL, inputs != NULL, matrix_get_cols(inputs) == network_get_input(N), and
+//              max_error, mean_error != NULL
+void qnetwork_error(qnetwork_t Q, network_t N, matrix_t inputs, double *max_error, double *mean_error);
+
+/**
+ * @brief returns the number of bytes a converted network occupies
+ * @param Q the network to query
+ */
+//Precondition: Q != NULL
+size_t qnetwork_get_bytes(qnetwork_t Q);
+
+/**
+ * @brief frees a converted network
+ * @param Q the network to free
+ */
+//Precondition: Q != NULL
+//Postcondition: Q is freed
+void qnetwork_free(qnetwork_t Q);
+
+#endif // QNETWORK_H
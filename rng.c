@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+
+struct rng_header{
+  uint64_t s[4];
+};
+typedef struct rng_header rng;
+
+// ziggurat tables for the standard normal (Marsaglia and Tsang, 128 layers)
+static uint32_t zig_k[128];
+static double zig_w[128];
+static double zig_f[128];
+static pthread_once_t zig_once = PTHREAD_ONCE_INIT;
+
+//helper functions
+
+uint64_t splitmix64(uint64_t *x){
+  uint64_t z = (*x += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k){
+  return (x << k) | (x >> (64 - k));
+}
+
+void zig_init(void){
+  const double m = 2147483648.0;
+  const double v = 9.91256303526217e-3;
+  double d = 3.442619855899;
+  double t = d;
+  double q = v / exp(-0.5 * d * d);
+
+  zig_k[0] = (uint32_t)((d / q) * m);
+  zig_k[1] = 0;
+  zig_w[0] = q / m;
+  zig_w[127] = d / m;
+  zig_f[0] = 1.0;
+  zig_f[127] = exp(-0.5 * d * d);
+  for(int i = 126; i >= 1; i--){
+    d = sqrt(-2.0 * log(v / d + exp(-0.5 * d * d)));
+    zig_k[i + 1] = (uint32_t)((d / t) * m);
+    t = d;
+    zig_f[i] = exp(-0.5 * d * d);
+    zig_w[i] = d / m;
+  }
+}
+//end helper functions
+
+void rng_seed(rng *R, uint64_t seed){
+  for(int i = 0; i < 4; i++){
+    R->s[i] = splitmix64(&seed);
+  }
+}
+
+rng *rng_new(uint64_t seed){
+  rng *R = malloc(sizeof(rng));
+  rng_seed(R, seed);
+  return R;
+}
+
+uint64_t rng_next(rng *R){
+  uint64_t *s = R->s;
+  uint64_t result = rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+unsigned int rng_below(rng *R, unsigned int n){
+  return (unsigned int)(((rng_next(R) >> 32) * (uint64_t)n) >> 32);
+}
+
+double rng_uniform(rng *R){
+  return (double)(rng_next(R) >> 11) * 0x1.0p-53;
+}
+
+//helper functions
+
+// uniform in (0, 1], safe to take the log of
+double rng_open_uniform(rng *R){
+  return ((double)(rng_next(R) >> 11) + 1.0) * 0x1.0p-53;
+}
+
+// the slow path of the ziggurat, taken for roughly 1 in 100 samples
+double rng_norm_tail(rng *R, int32_t h, unsigned int i){
+  const double r = 3.442619855899;
+  while(true){
+    double x = (double)h * zig_w[i];
+    if(i == 0){
+      double y;
+      do{
+        x = -log(rng_open_uniform(R)) / r;
+        y = -log(rng_open_uniform(R));
+      } while(y + y < x * x);
+      return h > 0 ? r + x : -r - x;
+    }
+    if(zig_f[i] + rng_uniform(R) * (zig_f[i - 1] - zig_f[i]) < exp(-0.5 * x * x)) return x;
+
+    h = (int32_t)(rng_next(R) >> 32);
+    i = h & 127;
+    if((uint32_t)labs(h) < zig_k[i]) return (double)h * zig_w[i];
+  }
+}
+//end helper functions
+
+double rng_norm(rng *R){
+  pthread_once(&zig_once, &zig_init);
+  int32_t h = (int32_t)(rng_next(R) >> 32);
+  unsigned int i = h & 127;
+  if((uint32_t)labs(h) < zig_k[i]) return (double)h * zig_w[i];
+  return rng_norm_tail(R, h, i);
+}
+
+void rng_free(rng *R){
+  free(R);
+}
@@ -0,0 +1,67 @@
+/**
+ * A small, seedable pseudo-random number generator (xoshiro256**) for the stochastic parts of NEAT.
+ * Every generator has its own state, so threads each using their own generator never contend on a lock,
+ * and a run seeded the same way makes the same random decisions. Normal samples use the ziggurat
+ * method, which almost always costs a single draw and a table lookup.
+ */
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+typedef struct rng_header *rng_t;
+
+/**
+ * @brief creates a new random number generator
+ * @param seed the seed of the generator
+ */
+//Postcondition: Result is not NULL
+rng_t rng_new(uint64_t seed);
+
+/**
+ * @brief resets a generator to the start of the sequence given by seed
+ * @param R the generator to reseed
+ * @param seed the new seed
+ */
+//Precondition: R != NULL
+void rng_seed(rng_t R, uint64_t seed);
+
+/**
+ * @brief returns 64 uniformly random bits
+ * @param R the generator to draw from
+ */
+//Precondition: R != NULL
+uint64_t rng_next(rng_t R);
+
+/**
+ * @brief returns a uniformly random integer in [0, n)
+ * @param R the generator to draw from
+ * @param n the exclusive upper bound
+ */
+//Precondition: R != NULL and n > 0
+//Postcondition: Result < n
+unsigned int rng_below(rng_t R, unsigned int n);
+
+/**
+ * @brief returns a uniformly random double in [0, 1)
+ * @param R the generator to draw from
+ */
+//Precondition: R != NULL
+double rng_uniform(rng_t R);
+
+/**
+ * @brief returns a sample from the standard normal distribution
+ * @param R the generator to draw from
+ */
+//Precondition: R != NULL
+double rng_norm(rng_t R);
+
+/**
+ * @brief frees a generator
+ * @param R the generator to free
+ */
+//Precondition: R != NULL
+//Postcondition: R is freed
+void rng_free(rng_t R);
+
+#endif // RNG_H
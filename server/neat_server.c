@@ -0,0 +1,482 @@
+/*
+    A daemon serving evaluations of saved networks over a Unix domain socket.
+
+    Networks are loaded with network_load, so they must use a built-in activation. Requests from all
+    clients are queued per network and run together through network_calc_batch once max_batch of them
+    are waiting or the oldest has waited max_wait microseconds. Raising max_wait trades latency for
+    throughput; the server reports the p50 and p99 latency, the throughput and the mean batch size every
+    report interval and when it exits.
+
+    Protocol, in the byte order of the server: a request is a uint32_t network index (the order the
+    networks were given on the command line) followed by one double per input of that network. The
+    response is one double per output. Requests on a connection are answered in order, even when they
+    go to different networks, and may be pipelined. A client may shut down its sending side once it has
+    sent its requests and still receives every answer. Once a client is owed CLIENT_MAX_BACKLOG bytes of
+    answers, the server stops reading its requests until it reads some answers back.
+
+    Build from the repository root with
+        cc -O2 -I. -o neat_server server/neat_server.c network.c matrix.c activation.c -lm
+    and run as
+        neat_server [-b max_batch] [-w max_wait_us] [-r report_seconds] socket_path network_file...
+*/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "network.h"
+#include "matrix.h"
+
+// the bytes of answers a client may be owed before the server stops reading its requests, so a client
+// that pipelines without reading can't grow the server's memory without bound
+#define CLIENT_MAX_BACKLOG (1 << 20)
+
+// an answer a client is owed, in the order it asked
+struct reply_header{
+  uint64_t end; // the position in the client's reply stream just past this answer
+  bool done;
+};
+typedef struct reply_header reply;
+
+struct client_header{
+  int fd;
+  uint64_t id; // never reused, so answers for a closed client are never sent to the next one
+  bool eof; // the client won't send anything more, close it once everything it asked for is sent
+  unsigned char *in;
+  size_t in_len;
+  size_t in_cap;
+  // room for every answer owed, in request order; requests to different networks finish out of order,
+  // so only the first out_ready bytes, whose answers are all computed, can be sent
+  unsigned char *out;
+  size_t out_pos;
+  size_t out_ready;
+  size_t out_len;
+  size_t out_cap;
+  uint64_t out_base; // the position in the reply stream of out[0]
+  // the answers owed, oldest first, from replies[reply_head] to replies[num_replies - 1]
+  reply *replies;
+  size_t reply_head;
+  size_t num_replies;
+  size_t reply_cap;
+  uint64_t reply_base; // the sequence number of replies[0]
+};
+typedef struct client_header client;
+
+// a request waiting for its batch to run
+struct pending_header{
+  size_t slot;
+  uint64_t id;
+  uint64_t seq; // the sequence number of its reply
+  uint64_t at; // where its answer goes in the reply stream
+  double arrival;
+};
+typedef struct pending_header pending;
+
+struct model_header{
+  network_t N;
+  size_t input;
+  size_t output;
+  double *inputs; // max_batch rows of input
+  pending *queue;
+  size_t count;
+};
+typedef struct model_header model;
+
+struct server_header{
+  int listen_fd;
+  size_t max_batch;
+  double max_wait; // seconds
+  double report_interval; // seconds
+  model *models;
+  size_t num_models;
+  client **clients; // NULL for free slots
+  size_t num_slots;
+  uint64_t next_id;
+  struct pollfd *fds;
+  // statistics since the last report
+  double *latencies;
+  size_t num_latencies;
+  size_t latency_cap;
+  size_t batches;
+  double last_report;
+};
+typedef struct server_header server;
+
+static volatile sig_atomic_t stop = 0;
+
+//helper functions
+
+void on_signal(int sig){
+  (void)sig;
+  stop = 1;
+}
+
+double now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+// makes sure buf has room for cap bytes
+void reserve(unsigned char **buf, size_t *cap, size_t bytes){
+  if(bytes <= *cap) return;
+  size_t new_cap = *cap == 0 ? 256 : *cap;
+  while(new_cap < bytes) new_cap *= 2;
+  *buf = realloc(*buf, new_cap);
+  *cap = new_cap;
+}
+
+void client_close(server *S, size_t slot){
+  client *C = S->clients[slot];
+  close(C->fd);
+  free(C->in);
+  free(C->out);
+  free(C->replies);
+  free(C);
+  S->clients[slot] = NULL;
+}
+
+// whether a client is owed enough answers that no more of its requests should be read
+bool client_backlogged(client *C){
+  return C->out_len - C->out_pos >= CLIENT_MAX_BACKLOG;
+}
+
+// writes as much computed output as the socket takes, returns false if the client is gone
+bool client_write(client *C){
+  while(C->out_pos < C->out_ready){
+    ssize_t n = send(C->fd, C->out + C->out_pos, C->out_ready - C->out_pos, MSG_NOSIGNAL);
+    if(n < 0){
+      if(errno == EINTR) continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    C->out_pos += (size_t)n;
+  }
+  // drop what has been sent, keeping the room reserved for answers still being computed
+  memmove(C->out, C->out + C->out_pos, C->out_len - C->out_pos);
+  C->out_len -= C->out_pos;
+  C->out_ready -= C->out_pos;
+  C->out_base += C->out_pos;
+  C->out_pos = 0;
+  return true;
+}
+
+// reserves room for the next answer of a client and returns its sequence number
+uint64_t client_expect(client *C, size_t bytes){
+  reserve(&C->out, &C->out_cap, C->out_len + bytes);
+  C->out_len += bytes;
+  if(C->num_replies == C->reply_cap){
+    if(C->reply_head > 0){
+      memmove(C->replies, C->replies + C->reply_head, (C->num_replies - C->reply_head) * sizeof(reply));
+      C->num_replies -= C->reply_head;
+      C->reply_base += C->reply_head;
+      C->reply_head = 0;
+    } else{
+      C->reply_cap = C->reply_cap == 0 ? 16 : 2 * C->reply_cap;
+      C->replies = realloc(C->replies, C->reply_cap * sizeof(reply));
+    }
+  }
+  C->replies[C->num_replies].end = C->out_base + C->out_len;
+  C->replies[C->num_replies].done = false;
+  C->num_replies++;
+  return C->reply_base + C->num_replies - 1;
+}
+
+// stores a computed answer and releases every answer up to the first one still being computed
+void client_answer(client *C, pending *P, double *values, size_t bytes){
+  memcpy(C->out + (P->at - C->out_base), values, bytes);
+  C->replies[P->seq - C->reply_base].done = true;
+  while(C->reply_head < C->num_replies && C->replies[C->reply_head].done){
+    C->out_ready = (size_t)(C->replies[C->reply_head].end - C->out_base);
+    C->reply_head++;
+  }
+  if(C->reply_head == C->num_replies){
+    C->reply_base += C->num_replies;
+    C->reply_head = 0;
+    C->num_replies = 0;
+  }
+}
+
+void record_latency(server *S, double latency){
+  if(S->num_latencies == S->latency_cap){
+    S->latency_cap = S->latency_cap == 0 ? 1024 : 2 * S->latency_cap;
+    S->latencies = realloc(S->latencies, S->latency_cap * sizeof(double));
+  }
+  S->latencies[S->num_latencies] = latency;
+  S->num_latencies++;
+}
+
+// runs every queued request of a model as one batch and queues the answers
+void model_flush(server *S, model *M){
+  if(M->count == 0) return;
+  matrix_t in = matrix_new(M->count, M->input);
+  matrix_t out = matrix_new(M->count, M->output);
+  memcpy(matrix_get_data(in), M->inputs, M->count * M->input * sizeof(double));
+  network_calc_batch(M->N, in, out);
+  double *results = matrix_get_data(out);
+  double done = now();
+  for(size_t r = 0; r < M->count; r++){
+    pending *P = &M->queue[r];
+    client *C = S->clients[P->slot];
+    if(C == NULL || C->id != P->id) continue;
+    client_answer(C, P, results + r * M->output, M->output * sizeof(double));
+    record_latency(S, done - P->arrival);
+  }
+  // answer right away instead of waiting for the next poll
+  for(size_t r = 0; r < M->count; r++){
+    pending *P = &M->queue[r];
+    client *C = S->clients[P->slot];
+    if(C != NULL && C->id == P->id && C->out_ready > C->out_pos && !client_write(C)) client_close(S, P->slot);
+  }
+  S->batches++;
+  M->count = 0;
+  matrix_free(in);
+  matrix_free(out);
+}
+
+// queues every complete request in the client's buffer, returns false on a malformed request
+bool client_parse(server *S, size_t slot){
+  client *C = S->clients[slot];
+  size_t pos = 0;
+  double arrival = now();
+  while(C->in_len - pos >= sizeof(uint32_t) && !client_backlogged(C)){
+    uint32_t index;
+    memcpy(&index, C->in + pos, sizeof(uint32_t));
+    if(index >= S->num_models) return false;
+    model *M = &S->models[index];
+    size_t bytes = sizeof(uint32_t) + M->input * sizeof(double);
+    if(C->in_len - pos < bytes) break;
+    memcpy(M->inputs + M->count * M->input, C->in + pos + sizeof(uint32_t), M->input * sizeof(double));
+    M->queue[M->count].slot = slot;
+    M->queue[M->count].id = C->id;
+    M->queue[M->count].at = C->out_base + C->out_len;
+    M->queue[M->count].seq = client_expect(C, M->output * sizeof(double));
+    M->queue[M->count].arrival = arrival;
+    M->count++;
+    pos += bytes;
+    if(M->count == S->max_batch){
+      model_flush(S, M);
+      // the flush closes this client if answering it failed
+      if(S->clients[slot] == NULL) return true;
+    }
+  }
+  memmove(C->in, C->in + pos, C->in_len - pos);
+  C->in_len -= pos;
+  return true;
+}
+
+// reads and queues what is available from a client until it is backlogged, returns false if it should
+// be closed
+bool client_read(server *S, size_t slot){
+  client *C = S->clients[slot];
+  // a client that already sent everything is only polled for reading to learn that it hung up
+  if(C->eof) return false;
+  // parsing after every read keeps the input buffer to about one read however much the client sends
+  while(!client_backlogged(C)){
+    reserve(&C->in, &C->in_cap, C->in_len + 4096);
+    ssize_t n = recv(C->fd, C->in + C->in_len, C->in_cap - C->in_len, 0);
+    if(n == 0){
+      // the requests that arrived before the end are still answered
+      C->eof = true;
+      return true;
+    }
+    if(n < 0){
+      if(errno == EINTR) continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    C->in_len += (size_t)n;
+    if(!client_parse(S, slot)) return false;
+    // the parse closes this client if answering it failed
+    if(S->clients[slot] == NULL) return true;
+  }
+  return true;
+}
+
+void server_accept(server *S){
+  while(true){
+    int fd = accept(S->listen_fd, NULL, NULL);
+    if(fd < 0) return;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    size_t slot = 0;
+    while(slot < S->num_slots && S->clients[slot] != NULL) slot++;
+    if(slot == S->num_slots){
+      S->num_slots = S->num_slots == 0 ? 16 : 2 * S->num_slots;
+      S->clients = realloc(S->clients, S->num_slots * sizeof(client *));
+      S->fds = realloc(S->fds, (S->num_slots + 1) * sizeof(struct pollfd));
+      for(size_t i = slot; i < S->num_slots; i++) S->clients[i] = NULL;
+    }
+    client *C = calloc(1, sizeof(client));
+    C->fd = fd;
+    C->id = S->next_id;
+    S->next_id++;
+    S->clients[slot] = C;
+  }
+}
+
+int compare_double(const void *a, const void *b){
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+void server_report(server *S, double time){
+  double elapsed = time - S->last_report;
+  if(S->num_latencies > 0){
+    qsort(S->latencies, S->num_latencies, sizeof(double), &compare_double);
+    double p50 = S->latencies[(S->num_latencies - 1) / 2];
+    double p99 = S->latencies[(S->num_latencies - 1) * 99 / 100];
+    fprintf(stderr, "%zu requests, %.0f/s, mean batch %.1f, p50 %.1fus, p99 %.1fus\n",
+            S->num_latencies, (double)S->num_latencies / elapsed, (double)S->num_latencies / (double)S->batches,
+            p50 * 1e6, p99 * 1e6);
+  }
+  S->num_latencies = 0;
+  S->batches = 0;
+  S->last_report = time;
+}
+
+int server_listen(const char *path){
+  struct sockaddr_un addr;
+  if(strlen(path) >= sizeof(addr.sun_path)) return -1;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0) return -1;
+  unlink(path);
+  if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0){
+    close(fd);
+    return -1;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+void server_run(server *S){
+  while(!stop){
+    // sleep until the oldest queued request is due or the next report
+    double time = now();
+    double deadline = S->last_report + S->report_interval;
+    for(size_t m = 0; m < S->num_models; m++){
+      model *M = &S->models[m];
+      if(M->count > 0 && M->queue[0].arrival + S->max_wait < deadline) deadline = M->queue[0].arrival + S->max_wait;
+    }
+    double wait = deadline > time ? deadline - time : 0.0;
+    struct timespec timeout = {(time_t)wait, (long)((wait - (double)(time_t)wait) * 1e9)};
+
+    S->fds[0].fd = S->listen_fd;
+    S->fds[0].events = POLLIN;
+    for(size_t i = 0; i < S->num_slots; i++){
+      client *C = S->clients[i];
+      S->fds[i + 1].fd = C == NULL ? -1 : C->fd;
+      bool readable = C != NULL && !C->eof && !client_backlogged(C);
+      S->fds[i + 1].events = C == NULL ? 0 : (readable ? POLLIN : 0) | (C->out_ready > C->out_pos ? POLLOUT : 0);
+      S->fds[i + 1].revents = 0;
+    }
+    size_t num_fds = S->num_slots + 1;
+    if(ppoll(S->fds, num_fds, &timeout, NULL) < 0 && errno != EINTR) break;
+
+    for(size_t i = 0; i + 1 < num_fds; i++){
+      short revents = S->fds[i + 1].revents;
+      if(revents == 0 || S->clients[i] == NULL) continue;
+      bool open = true;
+      if(revents & POLLOUT) open = client_write(S->clients[i]);
+      if(open && (revents & (POLLIN | POLLHUP | POLLERR))) open = client_read(S, i);
+      if(!open && S->clients[i] != NULL) client_close(S, i);
+    }
+    if(S->fds[0].revents & POLLIN) server_accept(S);
+
+    time = now();
+    for(size_t m = 0; m < S->num_models; m++){
+      model *M = &S->models[m];
+      if(M->count > 0 && M->queue[0].arrival + S->max_wait <= time) model_flush(S, M);
+    }
+    for(size_t i = 0; i < S->num_slots; i++){
+      // requests left unparsed while a client was backlogged are queued once its answers drain
+      client *C = S->clients[i];
+      if(C != NULL && C->in_len > 0 && !client_backlogged(C) && !client_parse(S, i)) client_close(S, i);
+      C = S->clients[i];
+      if(C != NULL && C->eof && C->out_len == 0) client_close(S, i);
+    }
+    if(time >= S->last_report + S->report_interval) server_report(S, time);
+  }
+  server_report(S, now());
+}
+//end helper functions
+
+int main(int argc, char **argv){
+  size_t max_batch = 64;
+  double max_wait_us = 200.0;
+  double report_seconds = 10.0;
+  int opt;
+  while((opt = getopt(argc, argv, "b:w:r:")) != -1){
+    switch(opt){
+      case 'b': max_batch = strtoul(optarg, NULL, 10); break;
+      case 'w': max_wait_us = strtod(optarg, NULL); break;
+      case 'r': report_seconds = strtod(optarg, NULL); break;
+      default: optind = argc + 1; break;
+    }
+  }
+  if(optind + 2 > argc || max_batch == 0 || max_wait_us < 0.0 || report_seconds <= 0.0){
+    fprintf(stderr, "usage: %s [-b max_batch] [-w max_wait_us] [-r report_seconds] socket_path network_file...\n",
+            argv[0]);
+    return 1;
+  }
+
+  server S;
+  memset(&S, 0, sizeof(server));
+  S.max_batch = max_batch;
+  S.max_wait = max_wait_us * 1e-6;
+  S.report_interval = report_seconds;
+  S.num_models = (size_t)(argc - optind - 1);
+  S.models = calloc(S.num_models, sizeof(model));
+  for(size_t m = 0; m < S.num_models; m++){
+    model *M = &S.models[m];
+    M->N = network_load(argv[optind + 1 + m], NULL);
+    if(M->N == NULL){
+      fprintf(stderr, "could not load %s\n", argv[optind + 1 + m]);
+      return 1;
+    }
+    M->input = network_get_input(M->N);
+    M->output = network_get_output(M->N);
+    M->inputs = malloc(max_batch * M->input * sizeof(double));
+    M->queue = malloc(max_batch * sizeof(pending));
+  }
+  S.listen_fd = server_listen(argv[optind]);
+  if(S.listen_fd < 0){
+    fprintf(stderr, "could not listen on %s\n", argv[optind]);
+    return 1;
+  }
+  S.fds = malloc(sizeof(struct pollfd));
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = &on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  S.last_report = now();
+  server_run(&S);
+
+  for(size_t i = 0; i < S.num_slots; i++){
+    if(S.clients[i] != NULL) client_close(&S, i);
+  }
+  close(S.listen_fd);
+  unlink(argv[optind]);
+  for(size_t m = 0; m < S.num_models; m++){
+    network_free(S.models[m].N);
+    free(S.models[m].inputs);
+    free(S.models[m].queue);
+  }
+  free(S.models);
+  free(S.clients);
+  free(S.fds);
+  free(S.latencies);
+  return 0;
+}
@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef void task_fn(void *arg, size_t i, size_t thread);
+
+typedef struct thread_pool_header thread_pool;
+
+// the indices [lo, hi) still to be processed by one thread
+struct range_header{
+  pthread_mutex_t lock;
+  size_t lo;
+  size_t hi;
+};
+typedef struct range_header range;
+
+struct worker_header{
+  thread_pool *P;
+  size_t index;
+  pthread_t thread;
+};
+typedef struct worker_header worker;
+
+struct thread_pool_header{
+  size_t threads;
+  worker *workers;
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t done;
+  size_t job; // incremented every time new work is posted
+  size_t running; // workers still busy with the current job
+  bool stop;
+  task_fn *fn;
+  void *arg;
+  range *ranges; // one per thread
+};
+
+//helper functions
+
+bool range_pop(range *R, size_t *i){
+  pthread_mutex_lock(&R->lock);
+  bool found = R->lo < R->hi;
+  if(found){
+    *i = R->lo;
+    R->lo++;
+  }
+  pthread_mutex_unlock(&R->lock);
+  return found;
+}
+
+// moves the upper half of the first non-empty range of another thread into the range of thread
+bool thread_pool_steal(thread_pool *P, size_t thread){
+  for(size_t k = 1; k < P->threads; k++){
+    range *victim = &P->ranges[(thread + k) % P->threads];
+    pthread_mutex_lock(&victim->lock);
+    size_t rem = victim->hi - victim->lo;
+    if(rem == 0){
+      pthread_mutex_unlock(&victim->lock);
+      continue;
+    }
+    size_t lo = victim->hi - (rem + 1) / 2;
+    size_t hi = victim->hi;
+    victim->hi = lo;
+    pthread_mutex_unlock(&victim->lock);
+
+    range *own = &P->ranges[thread];
+    pthread_mutex_lock(&own->lock);
+    own->lo = lo;
+    own->hi = hi;
+    pthread_mutex_unlock(&own->lock);
+    return true;
+  }
+  return false;
+}
+
+// each thread works through its own range and steals from the others once it runs dry, so
+// uneven work items balance out without every index going through one shared counter
+void thread_pool_work(thread_pool *P, size_t thread){
+  size_t i;
+  do{
+    while(range_pop(&P->ranges[thread], &i)) (*P->fn)(P->arg, i, thread);
+  } while(thread_pool_steal(P, thread));
+}
+
+void *thread_pool_worker(void *arg){
+  worker *W = (worker *)arg;
+  thread_pool *P = W->P;
+  size_t job = 0;
+  pthread_mutex_lock(&P->lock);
+  while(true){
+    while(!P->stop && P->job == job) pthread_cond_wait(&P->work, &P->lock);
+    if(P->stop) break;
+    job = P->job;
+    pthread_mutex_unlock(&P->lock);
+
+    thread_pool_work(P, W->index);
+
+    pthread_mutex_lock(&P->lock);
+    P->running--;
+    if(P->running == 0) pthread_cond_signal(&P->done);
+  }
+  pthread_mutex_unlock(&P->lock);
+  return NULL;
+}
+//end helper functions
+
+thread_pool *thread_pool_new(size_t threads){
+  thread_pool *P = malloc(sizeof(thread_pool));
+  P->threads = threads;
+  P->job = 0;
+  P->running = 0;
+  P->stop = false;
+  P->fn = NULL;
+  P->arg = NULL;
+  P->ranges = malloc(threads * sizeof(range));
+  for(size_t i = 0; i < threads; i++){
+    pthread_mutex_init(&P->ranges[i].lock, NULL);
+    P->ranges[i].lo = 0;
+    P->ranges[i].hi = 0;
+  }
+  pthread_mutex_init(&P->lock, NULL);
+  pthread_cond_init(&P->work, NULL);
+  pthread_cond_init(&P->done, NULL);
+  // the thread calling thread_pool_run is thread 0, so only threads - 1 workers are needed
+  P->workers = threads > 1 ? malloc((threads - 1) * sizeof(worker)) : NULL;
+  for(size_t i = 0; i < threads - 1; i++){
+    P->workers[i].P = P;
+    P->workers[i].index = i + 1;
+    pthread_create(&P->workers[i].thread, NULL, &thread_pool_worker, &P->workers[i]);
+  }
+  return P;
+}
+
+size_t thread_pool_get_threads(thread_pool *P){
+  return P->threads;
+}
+
+void thread_pool_run(thread_pool *P, size_t n, task_fn *fn, void *arg){
+  if(P->threads == 1 || n < 2){
+    for(size_t i = 0; i < n; i++) (*fn)(arg, i, 0);
+    return;
+  }
+
+  pthread_mutex_lock(&P->lock);
+  P->fn = fn;
+  P->arg = arg;
+  for(size_t i = 0; i < P->threads; i++){
+    P->ranges[i].lo = n * i / P->threads;
+    P->ranges[i].hi = n * (i + 1) / P->threads;
+  }
+  P->running = P->threads - 1;
+  P->job++;
+  pthread_cond_broadcast(&P->work);
+  pthread_mutex_unlock(&P->lock);
+
+  thread_pool_work(P, 0);
+
+  pthread_mutex_lock(&P->lock);
+  while(P->running > 0) pthread_cond_wait(&P->done, &P->lock);
+  pthread_mutex_unlock(&P->lock);
+}
+
+void thread_pool_free(thread_pool *P){
+  pthread_mutex_lock(&P->lock);
+  P->stop = true;
+  pthread_cond_broadcast(&P->work);
+  pthread_mutex_unlock(&P->lock);
+  for(size_t i = 0; i < P->threads - 1; i++){
+    pthread_join(P->workers[i].thread, NULL);
+  }
+  free(P->workers);
+  for(size_t i = 0; i < P->threads; i++){
+    pthread_mutex_destroy(&P->ranges[i].lock);
+  }
+  free(P->ranges);
+  pthread_mutex_destroy(&P->lock);
+  pthread_cond_destroy(&P->work);
+  pthread_cond_destroy(&P->done);
+  free(P);
+}
@@ -0,0 +1,57 @@
+/**
+ * A fixed set of worker threads for running data-parallel loops. A call to thread_pool_run hands the
+ * indices [0, n) out to the workers and the calling thread and only returns once every index has been
+ * processed, so the caller never has to join anything itself.
+ *
+ * Work is scheduled by stealing: every thread starts with an even share of the indices and takes half of
+ * another thread's remaining share whenever it runs out, so items of very different cost still balance.
+ */
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdlib.h>
+
+/**
+ * @brief a unit of work run by the pool
+ * @param arg the argument given to thread_pool_run
+ * @param i the index of the work item to process
+ * @param thread the index of the thread running the item (< thread_pool_get_threads)
+ */
+typedef void task_fn(void *arg, size_t i, size_t thread);
+
+typedef struct thread_pool_header *thread_pool_t;
+
+/**
+ * @brief creates a new thread pool
+ * @param threads the total number of threads to run work on, including the thread calling thread_pool_run
+ */
+//Precondition: threads > 0
+//Postcondition: Result is not NULL
+thread_pool_t thread_pool_new(size_t threads);
+
+/**
+ * @brief returns the number of threads work is spread across
+ * @param P the pool to query
+ */
+//Precondition: P != NULL
+size_t thread_pool_get_threads(thread_pool_t P);
+
+/**
+ * @brief calls fn(arg, i, thread) once for every i in [0, n) and waits for all of them to finish
+ * @param P the pool to run the work on
+ * @param n the number of work items
+ * @param fn the function to run on each item
+ * @param arg the argument passed to every call of fn
+ */
+//Precondition: P != NULL and fn != NULL
+void thread_pool_run(thread_pool_t P, size_t n, task_fn *fn, void *arg);
+
+/**
+ * @brief stops all worker threads and frees the pool
+ * @param P the pool to free
+ */
+//Precondition: P != NULL and no call to thread_pool_run on P is in progress
+//Postcondition: P is freed
+void thread_pool_free(thread_pool_t P);
+
+#endif // THREAD_POOL_H